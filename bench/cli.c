@@ -0,0 +1,122 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_BENCH
+#include "../clib.h"
+
+#define MAX_OPTIONS 64
+
+typedef struct {
+    size_t option_count;
+    char names[MAX_OPTIONS][32];
+    char* argv[2 * MAX_OPTIONS + 1];
+    int argc;
+} CliCtx;
+
+static Cstr short_options = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+static CliArguments make_arguments(CliCtx* cli){
+    CliArguments args = clib_make_cli_arguments(cli->option_count, NULL);
+    for(size_t i = 0; i < cli->option_count; ++i){
+        clib_add_arg(clib_create_argument(short_options[i], cli->names[i], "Option", required_argument), &args);
+    }
+    return args;
+}
+
+// Builds the argument list and parses every long option once
+static void bench_getopt(void* ctx, uint64_t iterations){
+    CliCtx* cli = (CliCtx*) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        CliArguments args = make_arguments(cli);
+        struct option* options = clib_get_options(args);
+        char* format = clib_generate_cli_format_string(args);
+
+        char* argv[2 * MAX_OPTIONS + 1];
+        memcpy(argv, cli->argv, sizeof(argv));
+
+        int opt, found = 0;
+        optind = 0;
+        opterr = 0;
+        while ((opt = getopt_long(cli->argc, argv, format, options, NULL)) != -1) {
+            found += opt;
+        }
+        CLIB_DO_NOT_OPTIMIZE(found);
+
+        free(format);
+        free(options);
+        clib_clean_arguments(&args);
+    }
+}
+
+typedef struct {
+    Cstr values[MAX_OPTIONS];
+} NativeValues;
+
+static void make_options(CliCtx* cli, ClibOption* options){
+    for(size_t i = 0; i < cli->option_count; ++i){
+        options[i] = (ClibOption) {
+            short_options[i], cli->names[i], "Option", CLIB_OPT_STRING, required_argument,
+            offsetof(NativeValues, values) + i * sizeof(Cstr),
+        };
+    }
+}
+
+// Builds the perfect hash for the table
+static void bench_native_init(void* ctx, uint64_t iterations){
+    CliCtx* cli = (CliCtx*) ctx;
+    ClibOption options[MAX_OPTIONS];
+    make_options(cli, options);
+
+    for(uint64_t i = 0; i < iterations; ++i){
+        ClibOptParser parser;
+        clib_opt_parser_init(&parser, options, cli->option_count);
+        CLIB_DO_NOT_OPTIMIZE(parser);
+    }
+}
+
+// Parses every long option once
+static void bench_native_parse(void* ctx, uint64_t iterations){
+    CliCtx* cli = (CliCtx*) ctx;
+    ClibOption options[MAX_OPTIONS];
+    make_options(cli, options);
+
+    ClibOptParser parser;
+    clib_opt_parser_init(&parser, options, cli->option_count);
+
+    for(uint64_t i = 0; i < iterations; ++i){
+        NativeValues values;
+        char* argv[2 * MAX_OPTIONS + 1];
+        memcpy(argv, cli->argv, sizeof(argv));
+
+        int argc = clib_opt_parse(&parser, cli->argc, argv, &values);
+        CLIB_DO_NOT_OPTIMIZE(argc);
+        CLIB_DO_NOT_OPTIMIZE(values);
+    }
+}
+
+int main(int argc, char** argv){
+    ClibBench bench = clib_bench_make((ClibBenchConfig) {0});
+    size_t sizes[] = {4, 16, 62};
+
+    static CliCtx cli;
+    for(size_t i = 0; i < ARRAY_LEN(sizes); ++i){
+        cli.option_count = sizes[i];
+        cli.argc = 0;
+        cli.argv[cli.argc++] = "bench";
+        for(size_t j = 0; j < cli.option_count; ++j){
+            snprintf(cli.names[j], sizeof(cli.names[j]), "option-%zu", j);
+        }
+        for(size_t j = 0; j < cli.option_count; ++j){
+            static char arguments[MAX_OPTIONS][48];
+            snprintf(arguments[j], sizeof(arguments[j]), "--%s=value", cli.names[j]);
+            cli.argv[cli.argc++] = arguments[j];
+        }
+
+        clib_bench_run(&bench, "getopt_long", sizes[i], bench_getopt, &cli);
+        clib_bench_run(&bench, "clib_opt_parser_init", sizes[i], bench_native_init, &cli);
+        clib_bench_run(&bench, "clib_opt_parse", sizes[i], bench_native_parse, &cli);
+    }
+
+    clib_bench_report(bench, clib_bench_format_from_args(argc, argv), stdout);
+    clib_bench_clean(&bench);
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_BENCH
+#include "../clib.h"
+
+typedef struct {
+    char source[64];
+    char destination[64];
+} FilesCtx;
+
+static void bench_read_file(void* ctx, uint64_t iterations){
+    FilesCtx* files = (FilesCtx*) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        char* buffer = clib_read_file(files->source);
+        CLIB_DO_NOT_OPTIMIZE(buffer);
+        free(buffer);
+    }
+}
+
+static void bench_copy_file(void* ctx, uint64_t iterations){
+    FilesCtx* files = (FilesCtx*) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        clib_copy_file(files->source, files->destination);
+    }
+}
+
+int main(int argc, char** argv){
+    ClibBench bench = clib_bench_make((ClibBenchConfig) {0});
+    size_t sizes[] = {1 << 10, 64 << 10, 1 << 20, 16 << 20};
+
+    FilesCtx files = {0};
+    snprintf(files.source, sizeof(files.source), "/tmp/clib_bench_src_%d", (int) getpid());
+    snprintf(files.destination, sizeof(files.destination), "/tmp/clib_bench_dst_%d", (int) getpid());
+
+    for(size_t i = 0; i < ARRAY_LEN(sizes); ++i){
+        char* data = (char*) clib_safe_malloc(sizes[i] + 1);
+        memset(data, 'a', sizes[i]);
+        data[sizes[i]] = '\0';
+        clib_write_file(files.source, data, "w");
+        free(data);
+
+        clib_bench_run(&bench, "clib_read_file", sizes[i], bench_read_file, &files);
+        clib_bench_run(&bench, "clib_copy_file", sizes[i], bench_copy_file, &files);
+    }
+
+    clib_delete_file(files.source);
+    clib_delete_file(files.destination);
+
+    clib_bench_report(bench, clib_bench_format_from_args(argc, argv), stdout);
+    clib_bench_clean(&bench);
+
+    return 0;
+}
@@ -0,0 +1,40 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_BENCH
+#include "../clib.h"
+
+static void bench_format_text(void* ctx, uint64_t iterations){
+    Cstr text = (Cstr) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        char* formatted = clib_format_text("%s %d %s", text, (int) i, "end");
+        CLIB_DO_NOT_OPTIMIZE(formatted);
+        free(formatted);
+    }
+}
+
+static void bench_format_scratch(void* ctx, uint64_t iterations){
+    Cstr text = (Cstr) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        Cstr formatted = clib_format_scratch("%s %d %s", text, (int) i, "end");
+        CLIB_DO_NOT_OPTIMIZE(formatted);
+    }
+}
+
+int main(int argc, char** argv){
+    ClibBench bench = clib_bench_make((ClibBenchConfig) {0});
+    size_t sizes[] = {16, 256, 4096, 65536};
+
+    for(size_t i = 0; i < ARRAY_LEN(sizes); ++i){
+        char* text = (char*) clib_safe_malloc(sizes[i] + 1);
+        memset(text, 'a', sizes[i]);
+        text[sizes[i]] = '\0';
+
+        clib_bench_run(&bench, "clib_format_text", sizes[i], bench_format_text, text);
+        clib_bench_run(&bench, "clib_format_scratch", sizes[i], bench_format_scratch, text);
+        free(text);
+    }
+
+    clib_bench_report(bench, clib_bench_format_from_args(argc, argv), stdout);
+    clib_bench_clean(&bench);
+
+    return 0;
+}
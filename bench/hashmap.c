@@ -0,0 +1,88 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_BENCH
+#include "../clib.h"
+
+#define KEYS 4096
+
+CLIB_HASHMAP(U64Map, u64map, uint64_t, uint64_t, clib_hash_u64, clib_u64_equal)
+
+static uint64_t keys[KEYS];
+static char names[KEYS][24];
+static U64Map map;
+static ClibInterner interner;
+
+static void bench_map_get(void* ctx, uint64_t iterations){
+    (void) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        uint64_t* value = u64map_get(&map, keys[i % KEYS]);
+        CLIB_DO_NOT_OPTIMIZE(value);
+    }
+}
+
+static void bench_map_put(void* ctx, uint64_t iterations){
+    (void) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        if(i % KEYS == 0) u64map_free(&map);
+        u64map_put(&map, keys[i % KEYS], i);
+    }
+}
+
+static void bench_intern(void* ctx, uint64_t iterations){
+    (void) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        uint32_t id = clib_intern(&interner, CLIB_VIEW(names[i % KEYS]));
+        CLIB_DO_NOT_OPTIMIZE(id);
+    }
+}
+
+// What the interner replaces: finding a name among a handful of others
+static void bench_strcmp_scan(void* ctx, uint64_t iterations){
+    (void) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        Cstr name = names[i % 16];
+        size_t found = 0;
+        while(strcmp(names[found], name) != 0) found++;
+        CLIB_DO_NOT_OPTIMIZE(found);
+    }
+}
+
+static void bench_id_scan(void* ctx, uint64_t iterations){
+    uint32_t* ids = (uint32_t*) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        uint32_t id = ids[i % 16];
+        size_t found = 0;
+        while(ids[found] != id) found++;
+        CLIB_DO_NOT_OPTIMIZE(found);
+    }
+}
+
+int main(int argc, char** argv){
+    uint64_t state = 88172645463325252ull;
+    for(size_t i = 0; i < KEYS; ++i){
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        keys[i] = state;
+        snprintf(names[i], sizeof(names[i]), "option.name-%zu", i);
+    }
+
+    u64map_init(&map);
+    clib_interner_init(&interner);
+    uint32_t ids[16];
+    for(size_t i = 0; i < 16; ++i) ids[i] = clib_intern(&interner, CLIB_VIEW(names[i]));
+
+    ClibBench bench = clib_bench_make((ClibBenchConfig) {0});
+
+    clib_bench_run(&bench, "hashmap put", KEYS, bench_map_put, NULL);
+    clib_bench_run(&bench, "hashmap get", KEYS, bench_map_get, NULL);
+    clib_bench_run(&bench, "clib_intern", KEYS, bench_intern, NULL);
+    clib_bench_run(&bench, "strcmp scan of 16", 16, bench_strcmp_scan, NULL);
+    clib_bench_run(&bench, "id scan of 16", 16, bench_id_scan, ids);
+
+    clib_bench_report(bench, clib_bench_format_from_args(argc, argv), stdout);
+    clib_bench_clean(&bench);
+    u64map_free(&map);
+    clib_interner_free(&interner);
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_BENCH
+#include "../clib.h"
+
+static void bench_log(void* ctx, uint64_t iterations){
+    Cstr text = (Cstr) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        CLIB_LOG(CLIB_INFO, "%s %d", text, (int) i);
+    }
+}
+
+static void bench_log_every_n(void* ctx, uint64_t iterations){
+    Cstr text = (Cstr) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        LOG_EVERY_N(stderr, "INFO", 1000, "%s %d", text, (int) i);
+    }
+}
+
+int main(int argc, char** argv){
+    ClibBench bench = clib_bench_make((ClibBenchConfig) {0});
+    size_t sizes[] = {16, 256, 4096};
+
+    // The lines themselves are not interesting, only the cost of producing them
+    if(freopen("/dev/null", "w", stderr) == NULL) {
+        perror("Error redirecting stderr");
+        return 1;
+    }
+
+    for(size_t i = 0; i < ARRAY_LEN(sizes); ++i){
+        char* text = (char*) clib_safe_malloc(sizes[i] + 1);
+        memset(text, 'a', sizes[i]);
+        text[sizes[i]] = '\0';
+
+        clib_log_init(0);
+        clib_bench_run(&bench, "clib_log", sizes[i], bench_log, text);
+        clib_log_init(CLIB_LOG_TIMESTAMP | CLIB_LOG_TID | CLIB_LOG_LOCATION);
+        clib_bench_run(&bench, "clib_log/prefixed", sizes[i], bench_log, text);
+        clib_bench_run(&bench, "LOG_EVERY_N/1000", sizes[i], bench_log_every_n, text);
+        free(text);
+    }
+
+    clib_bench_report(bench, clib_bench_format_from_args(argc, argv), stdout);
+    clib_bench_clean(&bench);
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_BENCH
+#include "../clib.h"
+
+#define VALUES 1024
+
+static uint64_t integers[VALUES];
+static double doubles[VALUES];
+
+static void bench_snprintf_u64(void* ctx, uint64_t iterations){
+    (void) ctx;
+    char buffer[CLIB_U64TOA_SIZE];
+    for(uint64_t i = 0; i < iterations; ++i){
+        int length = snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long) integers[i % VALUES]);
+        CLIB_DO_NOT_OPTIMIZE(length);
+    }
+}
+
+static void bench_u64toa(void* ctx, uint64_t iterations){
+    (void) ctx;
+    char buffer[CLIB_U64TOA_SIZE];
+    for(uint64_t i = 0; i < iterations; ++i){
+        size_t length = clib_u64toa(buffer, integers[i % VALUES]);
+        CLIB_DO_NOT_OPTIMIZE(length);
+    }
+}
+
+static void bench_snprintf_double(void* ctx, uint64_t iterations){
+    (void) ctx;
+    char buffer[CLIB_DTOA_SIZE];
+    for(uint64_t i = 0; i < iterations; ++i){
+        int length = snprintf(buffer, sizeof(buffer), "%.17g", doubles[i % VALUES]);
+        CLIB_DO_NOT_OPTIMIZE(length);
+    }
+}
+
+static void bench_dtoa(void* ctx, uint64_t iterations){
+    (void) ctx;
+    char buffer[CLIB_DTOA_SIZE];
+    for(uint64_t i = 0; i < iterations; ++i){
+        size_t length = clib_dtoa(buffer, doubles[i % VALUES]);
+        CLIB_DO_NOT_OPTIMIZE(length);
+    }
+}
+
+int main(int argc, char** argv){
+    // Values of every magnitude, from a fixed seed
+    uint64_t state = 88172645463325252ull;
+    for(size_t i = 0; i < VALUES; ++i){
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        integers[i] = state >> (i % 64);
+        doubles[i] = (double) (state >> 11) / (double) (1ull << (i % 60));
+    }
+
+    ClibBench bench = clib_bench_make((ClibBenchConfig) {0});
+
+    clib_bench_run(&bench, "snprintf %llu", 0, bench_snprintf_u64, NULL);
+    clib_bench_run(&bench, "clib_u64toa", 0, bench_u64toa, NULL);
+    clib_bench_run(&bench, "snprintf %.17g", 0, bench_snprintf_double, NULL);
+    clib_bench_run(&bench, "clib_dtoa", 0, bench_dtoa, NULL);
+
+    clib_bench_report(bench, clib_bench_format_from_args(argc, argv), stdout);
+    clib_bench_clean(&bench);
+
+    return 0;
+}
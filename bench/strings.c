@@ -0,0 +1,87 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_BENCH
+#include "../clib.h"
+
+#define TEXT_SIZE (1 << 20)
+
+static char text[TEXT_SIZE];
+static char scratch[TEXT_SIZE];
+
+static void bench_find(void* ctx, uint64_t iterations){
+    (void) ctx;
+    CstrView view = { text, TEXT_SIZE };
+    for(uint64_t i = 0; i < iterations; ++i){
+        size_t at = clib_str_find(view, CLIB_VIEW_LITERAL("needle"));
+        CLIB_DO_NOT_OPTIMIZE(at);
+    }
+}
+
+static void bench_find_any(void* ctx, uint64_t iterations){
+    (void) ctx;
+    CstrView view = { text, TEXT_SIZE };
+    for(uint64_t i = 0; i < iterations; ++i){
+        size_t at = clib_str_find_any(view, CLIB_VIEW_LITERAL("\"\\{}"));
+        CLIB_DO_NOT_OPTIMIZE(at);
+    }
+}
+
+static void bench_count_lines(void* ctx, uint64_t iterations){
+    (void) ctx;
+    CstrView view = { text, TEXT_SIZE };
+    for(uint64_t i = 0; i < iterations; ++i){
+        size_t lines = clib_str_count_lines(view);
+        CLIB_DO_NOT_OPTIMIZE(lines);
+    }
+}
+
+static void bench_to_upper(void* ctx, uint64_t iterations){
+    (void) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        clib_str_to_upper(scratch, TEXT_SIZE);
+        CLIB_DO_NOT_OPTIMIZE(scratch[0]);
+    }
+}
+
+static void bench_valid_utf8(void* ctx, uint64_t iterations){
+    (void) ctx;
+    CstrView view = { text, TEXT_SIZE };
+    for(uint64_t i = 0; i < iterations; ++i){
+        int valid = clib_str_valid_utf8(view);
+        CLIB_DO_NOT_OPTIMIZE(valid);
+    }
+}
+
+int main(int argc, char** argv){
+    // Lines of lowercase words, with the needle at the very end
+    uint64_t state = 88172645463325252ull;
+    for(size_t i = 0; i < TEXT_SIZE; ++i){
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        text[i] = state % 64 == 0 ? '\n' : state % 8 == 0 ? ' ' : 'a' + state % 26;
+    }
+    memcpy(text + TEXT_SIZE - 6, "needle", 6);
+    memcpy(scratch, text, TEXT_SIZE);
+
+    ClibBench bench = clib_bench_make((ClibBenchConfig) {0});
+    Cstr levels[] = { "scalar", "sse2", "avx2" };
+    Cstr functions[] = { "clib_str_find", "clib_str_find_any", "clib_str_count_lines", "clib_str_to_upper", "clib_str_valid_utf8" };
+    ClibBenchFunc benches[] = { bench_find, bench_find_any, bench_count_lines, bench_to_upper, bench_valid_utf8 };
+
+    // The report keeps the names, so each run gets its own
+    static char names[ARRAY_LEN(levels)][ARRAY_LEN(functions)][64];
+
+    for(size_t f = 0; f < ARRAY_LEN(functions); ++f){
+        for(int level = clib_simd_level(); level >= CLIB_SIMD_NONE; --level){
+            clib_simd_set_level((ClibSimdLevel) level);
+            snprintf(names[level][f], sizeof(names[level][f]), "%s (%s)", functions[f], levels[level]);
+            clib_bench_run(&bench, names[level][f], TEXT_SIZE, benches[f], NULL);
+        }
+        clib_simd_set_level(CLIB_SIMD_AVX2);
+    }
+
+    clib_bench_report(bench, clib_bench_format_from_args(argc, argv), stdout);
+    clib_bench_clean(&bench);
+
+    return 0;
+}
@@ -0,0 +1,32 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_BENCH
+#include "../clib.h"
+
+static void bench_execute_command(void* ctx, uint64_t iterations){
+    Cstr command = (Cstr) ctx;
+    for(uint64_t i = 0; i < iterations; ++i){
+        char* output = clib_execute_command(command);
+        CLIB_DO_NOT_OPTIMIZE(output);
+        free(output);
+    }
+}
+
+int main(int argc, char** argv){
+    // Every iteration spawns a shell, so fewer and longer samples
+    ClibBench bench = clib_bench_make((ClibBenchConfig) {
+        .sample_ms = 50,
+        .samples = 15,
+    });
+    size_t sizes[] = {0, 4 << 10, 1 << 20};
+
+    for(size_t i = 0; i < ARRAY_LEN(sizes); ++i){
+        char command[64];
+        snprintf(command, sizeof(command), "head -c %zu /dev/zero | tr '\\0' a", sizes[i]);
+        clib_bench_run(&bench, "clib_execute_command", sizes[i], bench_execute_command, command);
+    }
+
+    clib_bench_report(bench, clib_bench_format_from_args(argc, argv), stdout);
+    clib_bench_clean(&bench);
+
+    return 0;
+}
@@ -27,6 +27,13 @@
  * Usage: 
  * #define CLIB_IMPLEMENTATION
  * #define CLIB_MENUS // if you want to use the menu methods
+ * #define CLIB_BENCH // if you want to use the benchmark harness
+ * #define CLIB_PROFILE // if you want the profiling zones to be recorded
+ * #define CLIB_CONFIG // if you want to use the layered configuration
+ * #define CLIB_PROGRESS // if you want to use the progress bars (needs -pthread)
+ * #define CLIB_WATCHER // if you want to watch files for changes (Linux only)
+ * #define CLIB_CSV // if you want to use the CSV reader (needs -pthread)
+ * #define CLIB_METRICS // if you want the library and your code to keep metrics (needs -pthread)
  * #inlcude "clib.h"
  *
  * -[TOC]-
@@ -34,10 +41,19 @@
  * 2. MEMORY
  * 3. MENUS // needs its own define!
  * 4. UTILS
- * 5. ANSI
- * 6. FILES
- * 7. LOGGING
- * 8. CLI
+ * 5. STRINGS
+ * 6. HASHMAP
+ * 7. ANSI
+ * 8. FILES
+ * 9. LOGGING
+ * 10. CLI
+ * 11. BENCH // needs its own define!
+ * 12. PROFILE // needs its own define!
+ * 13. CONFIG // needs its own define!
+ * 14. PROGRESS // needs its own define!
+ * 15. WATCHER // needs its own define!
+ * 16. CSV // needs its own define!
+ * 17. METRICS // needs its own define!
  * */
 
 #ifndef CLIB_H
@@ -55,22 +71,47 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
 #include <sys/types.h>
 #include <getopt.h>
+#include <time.h>
+#include <stdatomic.h>
+#ifndef _WIN32
+    #include <unistd.h>
+    #include <sys/ioctl.h>
+    #include <pthread.h>
+#endif
+#ifndef STDOUT_FILENO
+    #define STDOUT_FILENO 1
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+    // The AVX2 kernels are compiled with a target attribute and picked at runtime
+    #define CLIB_STR_SIMD
+    #include <immintrin.h>
+#endif
+#ifdef __linux__
+    #include <sys/syscall.h>
+#endif
 
 // START [TYPES] START //
 typedef const char * Cstr;
 typedef uint8_t Bool;
 
 typedef struct {
-    Cstr** items;
+    Cstr* items;
     size_t count;
 } CstrArray;
 
+// A string that is not necessarily NUL-terminated
+typedef struct {
+    Cstr data;
+    size_t length;
+} CstrView;
+
 typedef struct {
     char* help;
     char* full;
@@ -84,6 +125,60 @@ typedef struct {
     size_t capacity;
 } CliArguments;
 
+typedef enum {
+    CLIB_OPT_FLAG,   // int, set to 1
+    CLIB_OPT_STRING, // Cstr, points into argv
+    CLIB_OPT_INT,    // int
+    CLIB_OPT_LONG,   // long
+    CLIB_OPT_DOUBLE, // double
+} ClibOptType;
+
+// An entry of a static option table. The parsed value is written
+// `offset` bytes into the struct passed to clib_opt_parse.
+typedef struct {
+    char abr;  // 0 if there is no short form
+    Cstr full; // NULL if there is no long form
+    Cstr help;
+    ClibOptType type;
+    size_t argument_required;
+    size_t offset;
+} ClibOption;
+
+#define CLIB_OPTION(abr, full, help, type, argument_required, Struct, field) \
+    { abr, full, help, type, argument_required, offsetof(Struct, field) }
+
+#define CLIB_OPT_MAX 128
+
+// A node of a subcommand tree. The tables are static, so nothing is built
+// for a command unless it is the one being run.
+typedef struct ClibCommand ClibCommand;
+typedef int (*ClibCommandFunc)(int argc, char** argv, void* values, void* ctx);
+
+struct ClibCommand {
+    Cstr name;
+    Cstr help;
+    const ClibOption* options;
+    size_t option_count;
+    void* values; // struct the options are parsed into, passed to the handler
+    ClibCommandFunc handler; // NULL for pure groups
+    const ClibCommand* children;
+    size_t child_count;
+};
+
+#define CLIB_COMMAND_MAX_DEPTH 16
+
+// Long options are found with a hash-and-displace perfect hash that
+// clib_opt_parser_init builds once for the table
+typedef struct {
+    const ClibOption* options;
+    size_t count;
+    uint32_t bucket_mask;
+    uint32_t slot_mask;
+    uint8_t shorts[256]; // abr -> option index + 1
+    uint16_t displacements[CLIB_OPT_MAX];
+    uint8_t slots[2 * CLIB_OPT_MAX]; // option index + 1
+} ClibOptParser;
+
 // END [TYPES] END//
 
 // START [DECLARATIONS] START //
@@ -104,14 +199,46 @@ typedef struct {
 #define ITALIC "\e[3m"
 #define CLEAR "\e[2J"
 #define ERASE_LINE "\e[2K"
-#define HIDE_CURSOR() printf("\e[?25l")
-#define SHOW_CURSOR() printf("\e[?25h")
-#define GOTOXY(x,y) printf("\033[%d;%dH", (y), (x))
-#define MOVE_CURSOR_UP(x) printf("\033[%zuA", x)
-#define MOVE_CURSOR_DOWN(x) printf("\033[%dB", x);
-#define MOVE_CURSOR_RIGHT(x) printf("\033[%dC", x);
-#define MOVE_CURSOR_LEFT(x) printf("\033[%dD", x);
-#define CLEAR_BELOW_CURSOR printf("\033[J")
+#define HIDE_CURSOR() CLIB_TERM_LITERAL("\e[?25l")
+#define SHOW_CURSOR() CLIB_TERM_LITERAL("\e[?25h")
+#define GOTOXY(x,y) clib_term_printf("\033[%d;%dH", (y), (x))
+#define MOVE_CURSOR_UP(x) clib_term_printf("\033[%zuA", x)
+#define MOVE_CURSOR_DOWN(x) clib_term_printf("\033[%dB", x);
+#define MOVE_CURSOR_RIGHT(x) clib_term_printf("\033[%dC", x);
+#define MOVE_CURSOR_LEFT(x) clib_term_printf("\033[%dD", x);
+#define CLEAR_BELOW_CURSOR CLIB_TERM_LITERAL("\033[J")
+
+#define SYNC_UPDATE_BEGIN "\e[?2026h"
+#define SYNC_UPDATE_END "\e[?2026l"
+
+// Output buffer for terminal frames. While one is made active with
+// clib_term_begin, the ANSI macros and the print option callbacks write
+// into it, and clib_term_end sends the whole frame with a single write.
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    int fd;
+    int sync; // wrap frames in synchronized update markers
+    int styled; // whether an SGR other than a reset was sent since the last reset
+    char last_sgr[32];
+} ClibTermBuf;
+
+CLIBAPI void clib_termbuf_init(ClibTermBuf* tb, int fd);
+CLIBAPI void clib_termbuf_free(ClibTermBuf* tb);
+CLIBAPI void clib_termbuf_write(ClibTermBuf* tb, Cstr data, size_t length);
+CLIBAPI void clib_termbuf_printf(ClibTermBuf* tb, Cstr format, ...);
+CLIBAPI void clib_termbuf_flush(ClibTermBuf* tb);
+CLIBAPI int clib_term_supports_sync();
+CLIBAPI void clib_term_begin(ClibTermBuf* tb);
+CLIBAPI void clib_term_end();
+CLIBAPI void clib_term_write(Cstr data, size_t length);
+CLIBAPI void clib_term_printf(Cstr format, ...);
+CLIBAPI ClibTermBuf* clib_term_redirect(ClibTermBuf* tb);
+CLIBAPI void clib_term_size(int* columns, int* rows);
+
+#define CLIB_TERM_LITERAL(s) clib_term_write(s, sizeof(s) - 1)
+#define CLIB_TERMBUF_LITERAL(tb, s) clib_termbuf_write(tb, s, sizeof(s) - 1)
 
 #define ANSI_BLACK "\e[0;30m"
 #define ANSI_RED "\e[0;31m"
@@ -123,13 +250,81 @@ typedef struct {
 #define ANSI_LGREY "\e[0;37m"
 #define ANSI_DGREY "\e[0;38m"
 
+// Expands X(0) ... X(255), used to build the byte-indexed tables at compile time
+#define CLIB__BYTE_VALUES(X) \
+    X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7) X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15) \
+    X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31) \
+    X(32) X(33) X(34) X(35) X(36) X(37) X(38) X(39) X(40) X(41) X(42) X(43) X(44) X(45) X(46) X(47) \
+    X(48) X(49) X(50) X(51) X(52) X(53) X(54) X(55) X(56) X(57) X(58) X(59) X(60) X(61) X(62) X(63) \
+    X(64) X(65) X(66) X(67) X(68) X(69) X(70) X(71) X(72) X(73) X(74) X(75) X(76) X(77) X(78) X(79) \
+    X(80) X(81) X(82) X(83) X(84) X(85) X(86) X(87) X(88) X(89) X(90) X(91) X(92) X(93) X(94) X(95) \
+    X(96) X(97) X(98) X(99) X(100) X(101) X(102) X(103) X(104) X(105) X(106) X(107) X(108) X(109) X(110) X(111) \
+    X(112) X(113) X(114) X(115) X(116) X(117) X(118) X(119) X(120) X(121) X(122) X(123) X(124) X(125) X(126) X(127) \
+    X(128) X(129) X(130) X(131) X(132) X(133) X(134) X(135) X(136) X(137) X(138) X(139) X(140) X(141) X(142) X(143) \
+    X(144) X(145) X(146) X(147) X(148) X(149) X(150) X(151) X(152) X(153) X(154) X(155) X(156) X(157) X(158) X(159) \
+    X(160) X(161) X(162) X(163) X(164) X(165) X(166) X(167) X(168) X(169) X(170) X(171) X(172) X(173) X(174) X(175) \
+    X(176) X(177) X(178) X(179) X(180) X(181) X(182) X(183) X(184) X(185) X(186) X(187) X(188) X(189) X(190) X(191) \
+    X(192) X(193) X(194) X(195) X(196) X(197) X(198) X(199) X(200) X(201) X(202) X(203) X(204) X(205) X(206) X(207) \
+    X(208) X(209) X(210) X(211) X(212) X(213) X(214) X(215) X(216) X(217) X(218) X(219) X(220) X(221) X(222) X(223) \
+    X(224) X(225) X(226) X(227) X(228) X(229) X(230) X(231) X(232) X(233) X(234) X(235) X(236) X(237) X(238) X(239) \
+    X(240) X(241) X(242) X(243) X(244) X(245) X(246) X(247) X(248) X(249) X(250) X(251) X(252) X(253) X(254) X(255)
+
+// "\e[48;2;255;255;255m" and the terminator
+#define CLIB_COLOR_RGB_SIZE 24
+
 CLIBAPI Cstr clib_color(int color, int bg);
+CLIBAPI CstrView clib_color_view(int color, int bg);
+CLIBAPI size_t clib_color_rgb(char* buffer, uint8_t r, uint8_t g, uint8_t b, int bg);
 CLIBAPI void clib_clear_screen();
 CLIBAPI void clib_print_color_table();
 
 #define COLOR_BG(c) clib_color(c, 1)
 #define COLOR_FG(c) clib_color(c, 0)
 
+// Columns a string takes on the terminal: escape sequences take none and
+// every UTF-8 character takes one
+CLIBAPI size_t clib_display_width(Cstr text, size_t length);
+
+// Tables are written row by row as they come, through one buffered writer,
+// so memory does not grow with the number of rows
+typedef enum {
+    CLIB_TABLE_FIXED,    // columns keep the widths they are given, even under a longer header
+    CLIB_TABLE_SAMPLED,  // widths fit the headers and the first `sample` rows, which are held back until then
+    CLIB_TABLE_TWO_PASS, // widths fit the headers and the rows passed to clib_table_measure before the first clib_table_row
+} ClibTableMode;
+
+typedef struct {
+    Cstr header;
+    size_t width;     // the width in fixed mode, the least width otherwise
+    size_t max_width; // caps the measured width, 0 for no cap
+    int align_right;
+} ClibTableColumn;
+
+#define CLIB_TABLE_SAMPLE 100
+#define CLIB_TABLE_FLUSH_SIZE (64 * 1024)
+
+typedef struct {
+    ClibTableColumn* columns;
+    size_t column_count;
+    ClibTableMode mode;
+    size_t sample;   // rows to fit in sampled mode, 0 for CLIB_TABLE_SAMPLE
+    int truncate;    // cut cells wider than their column instead of letting them overflow
+    Cstr separator;  // between columns, NULL for two spaces
+    ClibTermBuf out;
+    int tty;         // cells are written as they are unless the output is a terminal
+    Cstr* scratch;   // column_count cells, for the header and the held rows
+    int started;     // the header has been written
+    char* held;      // rows held back while sampling, as NUL-terminated cells
+    size_t held_length;
+    size_t held_capacity;
+    size_t held_rows;
+} ClibTable;
+
+CLIBAPI void clib_table_init(ClibTable* table, ClibTableColumn* columns, size_t column_count, ClibTableMode mode, int fd);
+CLIBAPI void clib_table_measure(ClibTable* table, Cstr* cells);
+CLIBAPI void clib_table_row(ClibTable* table, Cstr* cells);
+CLIBAPI void clib_table_finish(ClibTable* table);
+
 // SYSTEM
 #ifndef _WIN32
 CLIBAPI char* clib_execute_command(const char* command);
@@ -175,11 +370,412 @@ CLIBAPI int clib_file_exists(const char *filename);
     #define UNLIKELY(x) (x)
 #endif
 
+#if defined(_MSC_VER)
+    #define CLIB_THREAD_LOCAL __declspec(thread)
+#else
+    #define CLIB_THREAD_LOCAL __thread
+#endif
+
 CLIBAPI int clib_eu_mod(int a, int b);
-#define ITOA(s, i) sprintf(s, "%d", i);
-#define FTOA(s, f) sprintf(s, "%f", f);
+CLIBAPI uint64_t clib_thread_id();
+
+// Number to text without locale or format parsing. The text is written to
+// buffer with a NUL, and its length is returned.
+#define CLIB_U64TOA_SIZE 21
+#define CLIB_I64TOA_SIZE 21
+#define CLIB_DTOA_SIZE 32
+CLIBAPI size_t clib_u64toa(char* buffer, uint64_t value);
+CLIBAPI size_t clib_u64toa_width(char* buffer, uint64_t value, size_t min_width);
+CLIBAPI size_t clib_i64toa(char* buffer, int64_t value);
+CLIBAPI size_t clib_dtoa(char* buffer, double value);
+#define ITOA(s, i) clib_i64toa(s, i)
+// Not the "%f" output it used to be: 0.1 gives "0.1" and 1e21 gives "1e+21"
+#define FTOA(s, f) clib_dtoa(s, f)
+
+// The low half of a 64x64-bit product, with the high half in *high
+static inline uint64_t clib__mul_u64(uint64_t a, uint64_t b, uint64_t* high){
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = (unsigned __int128) a * b;
+    *high = (uint64_t) (product >> 64);
+    return (uint64_t) product;
+#else
+    uint64_t a_low = (uint32_t) a, a_high = a >> 32;
+    uint64_t b_low = (uint32_t) b, b_high = b >> 32;
+    uint64_t low_low = a_low * b_low;
+    uint64_t high_low = a_high * b_low;
+    uint64_t cross = (low_low >> 32) + (uint32_t) high_low + a_low * b_high;
+    *high = a_high * b_high + (high_low >> 32) + (cross >> 32);
+    return (cross << 32) | (uint32_t) low_low;
+#endif
+}
+
+// Leading zero bits of a nonzero value
+static inline int clib__clz64(uint64_t value){
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_clzll(value);
+#else
+    int count = 0;
+    for(uint64_t bit = 1ull << 63; (value & bit) == 0; bit >>= 1) count++;
+    return count;
+#endif
+}
+
+// Trailing zero bits of a nonzero value
+static inline int clib__ctz32(uint32_t value){
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(value);
+#else
+    int count = 0;
+    for(uint32_t bit = 1; (value & bit) == 0; bit <<= 1) count++;
+    return count;
+#endif
+}
+
+static inline int clib__ctz64(uint64_t value){
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    int count = 0;
+    for(uint64_t bit = 1; (value & bit) == 0; bit <<= 1) count++;
+    return count;
+#endif
+}
 CLIBAPI char* clib_format_text(const char *format, ...);
 
+// Formats into one of CLIB_SCRATCH_COUNT buffers that each thread cycles
+// through. The result must not be freed and stays valid until that many
+// more calls on the same thread. Only output longer than CLIB_SCRATCH_SIZE
+// allocates, once per buffer, and the buffer then keeps the larger size.
+#define CLIB_SCRATCH_COUNT 8
+#define CLIB_SCRATCH_SIZE 256
+CLIBAPI Cstr clib_format_scratch(const char *format, ...);
+CLIBAPI Cstr clib_vformat_scratch(const char *format, va_list args);
+CLIBAPI void clib_scratch_release();
+
+// STRINGS
+// Views are searched by length, so they need no NUL and can point into
+// the middle of a buffer
+#define CLIB_VIEW(s) ((CstrView) { (s), strlen(s) })
+#define CLIB_VIEW_LITERAL(s) ((CstrView) { (s), sizeof(s) - 1 })
+#define CLIB_STR_NPOS ((size_t) -1)
+
+typedef enum {
+    CLIB_SIMD_NONE,
+    CLIB_SIMD_SSE2,
+    CLIB_SIMD_AVX2,
+} ClibSimdLevel;
+
+CLIBAPI ClibSimdLevel clib_simd_level();
+CLIBAPI void clib_simd_set_level(ClibSimdLevel level);
+CLIBAPI size_t clib_str_find(CstrView text, CstrView needle);
+CLIBAPI size_t clib_str_find_any(CstrView text, CstrView set);
+CLIBAPI size_t clib_str_count_byte(CstrView text, char byte);
+CLIBAPI size_t clib_str_count_lines(CstrView text);
+CLIBAPI int clib_str_split_next(CstrView* rest, CstrView delimiter, CstrView* part);
+CLIBAPI CstrView clib_str_trim(CstrView text);
+CLIBAPI char* clib_str_replace(CstrView text, CstrView from, CstrView to, size_t* length);
+CLIBAPI void clib_str_to_lower(char* data, size_t length);
+CLIBAPI void clib_str_to_upper(char* data, size_t length);
+CLIBAPI int clib_str_valid_utf8(CstrView text);
+
+// HASHMAP
+// Open addressing over groups of 16 slots. Each slot has a control byte:
+// empty, deleted, or the low 7 bits of its key's hash, so a lookup checks
+// a whole group with one compare and only tests keys whose bits match.
+#define CLIB_HASHMAP_GROUP 16
+#define CLIB_HASHMAP_EMPTY ((int8_t) -128)
+#define CLIB_HASHMAP_DELETED ((int8_t) -2)
+
+// Bit i is set when byte i of the group is `byte`
+static inline uint32_t clib__group_match(const int8_t* group, int8_t byte){
+#ifdef CLIB_STR_SIMD
+    __m128i chunk = _mm_loadu_si128((const __m128i*) group);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(byte)));
+#else
+    uint32_t mask = 0;
+    for(int i = 0; i < CLIB_HASHMAP_GROUP; ++i) mask |= (uint32_t) (group[i] == byte) << i;
+    return mask;
+#endif
+}
+
+// Empty and deleted slots are the negative control bytes
+static inline uint32_t clib__group_match_free(const int8_t* group){
+#ifdef CLIB_STR_SIMD
+    return (uint32_t) _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) group));
+#else
+    uint32_t mask = 0;
+    for(int i = 0; i < CLIB_HASHMAP_GROUP; ++i) mask |= (uint32_t) (group[i] < 0) << i;
+    return mask;
+#endif
+}
+
+static inline uint64_t clib__hash_mix(uint64_t a, uint64_t b){
+    uint64_t high;
+    uint64_t low = clib__mul_u64(a, b, &high);
+    return low ^ high;
+}
+
+// Reads 8 bytes at a time and folds them in with a 128-bit multiply
+static inline uint64_t clib_hash_bytes(const void* data, size_t length){
+    const unsigned char* p = (const unsigned char*) data;
+    uint64_t hash = clib__hash_mix(length ^ 0x9e3779b97f4a7c15ull, 0xa0761d6478bd642full);
+
+    for(; length >= 8; p += 8, length -= 8){
+        uint64_t word;
+        memcpy(&word, p, 8);
+        hash = clib__hash_mix(hash ^ word, 0xe7037ed1a0b428dbull);
+    }
+    if(length > 0){
+        uint64_t word = 0;
+        memcpy(&word, p, length);
+        hash = clib__hash_mix(hash ^ word, 0x8ebc6af09c88c6e3ull);
+    }
+    return clib__hash_mix(hash, 0x589965cc75374cc3ull);
+}
+
+static inline uint64_t clib_hash_u64(uint64_t value){
+    return clib__hash_mix(value ^ 0x9e3779b97f4a7c15ull, 0xa0761d6478bd642full);
+}
+
+static inline uint64_t clib_hash_view(CstrView view){
+    return clib_hash_bytes(view.data, view.length);
+}
+
+static inline uint64_t clib_hash_cstr(Cstr s){
+    return clib_hash_bytes(s, strlen(s));
+}
+
+static inline int clib_view_equal(CstrView a, CstrView b){
+    return a.length == b.length && memcmp(a.data, b.data, a.length) == 0;
+}
+
+static inline int clib_cstr_equal(Cstr a, Cstr b){
+    return strcmp(a, b) == 0;
+}
+
+static inline int clib_u64_equal(uint64_t a, uint64_t b){
+    return a == b;
+}
+
+// Declares the map type `Name` and its entry type `Name##Entry`
+#define CLIB_HASHMAP_TYPE(Name, K, V) \
+    typedef struct { \
+        K key; \
+        V value; \
+    } Name##Entry; \
+    \
+    typedef struct { \
+        int8_t* ctrl; \
+        Name##Entry* entries; \
+        size_t capacity; /* slots: zero, or a power of two of at least a group */ \
+        size_t count; \
+        size_t deleted; \
+    } Name;
+
+// Defines prefix##_init, _free, _find, _get, _emplace, _put, _remove and
+// _next for a map declared with CLIB_HASHMAP_TYPE. hash(K) returns a
+// uint64_t and equal(K, K) is nonzero for equal keys.
+//
+// Iterate with:
+//     for(size_t i = prefix##_next(&map, 0); i < map.capacity; i = prefix##_next(&map, i + 1))
+//         use(map.entries[i].key, map.entries[i].value);
+#define CLIB_HASHMAP_IMPL(Name, prefix, K, V, hash, equal) \
+    static inline void prefix##_init(Name* map){ \
+        *map = (Name) {0}; \
+    } \
+    \
+    static inline void prefix##_free(Name* map){ \
+        free(map->ctrl); \
+        free(map->entries); \
+        *map = (Name) {0}; \
+    } \
+    \
+    static inline Name##Entry* prefix##_find(const Name* map, K key){ \
+        if(map->count == 0) return NULL; \
+        uint64_t h = hash(key); \
+        size_t groups = map->capacity / CLIB_HASHMAP_GROUP; \
+        size_t group = (h >> 7) & (groups - 1); \
+        for(size_t step = 1; ; ++step){ \
+            const int8_t* ctrl = map->ctrl + group * CLIB_HASHMAP_GROUP; \
+            for(uint32_t mask = clib__group_match(ctrl, (int8_t) (h & 0x7f)); mask; mask &= mask - 1){ \
+                Name##Entry* entry = &map->entries[group * CLIB_HASHMAP_GROUP + clib__ctz32(mask)]; \
+                if(equal(entry->key, key)) return entry; \
+            } \
+            if(clib__group_match(ctrl, CLIB_HASHMAP_EMPTY)) return NULL; \
+            group = (group + step) & (groups - 1); \
+        } \
+    } \
+    \
+    static inline V* prefix##_get(const Name* map, K key){ \
+        Name##Entry* entry = prefix##_find(map, key); \
+        return entry ? &entry->value : NULL; \
+    } \
+    \
+    /* First free slot on the probe sequence of h */ \
+    static inline size_t prefix##__free_slot(const Name* map, uint64_t h){ \
+        size_t groups = map->capacity / CLIB_HASHMAP_GROUP; \
+        size_t group = (h >> 7) & (groups - 1); \
+        for(size_t step = 1; ; ++step){ \
+            uint32_t mask = clib__group_match_free(map->ctrl + group * CLIB_HASHMAP_GROUP); \
+            if(mask) return group * CLIB_HASHMAP_GROUP + clib__ctz32(mask); \
+            group = (group + step) & (groups - 1); \
+        } \
+    } \
+    \
+    /* Rebuilds the table without deleted slots, growing it so the live */ \
+    /* entries fill at most 7/16 of it */ \
+    static inline void prefix##__rehash(Name* map){ \
+        size_t capacity = map->capacity ? map->capacity : CLIB_HASHMAP_GROUP; \
+        while(map->count * 16 > capacity * 7) capacity *= 2; \
+        \
+        Name old = *map; \
+        map->capacity = capacity; \
+        map->deleted = 0; \
+        map->ctrl = (int8_t*) clib_safe_malloc(capacity); \
+        map->entries = (Name##Entry*) clib_safe_malloc(capacity * sizeof(Name##Entry)); \
+        memset(map->ctrl, CLIB_HASHMAP_EMPTY, capacity); \
+        \
+        for(size_t i = 0; i < old.capacity; ++i){ \
+            if(old.ctrl[i] < 0) continue; \
+            uint64_t h = hash(old.entries[i].key); \
+            size_t slot = prefix##__free_slot(map, h); \
+            map->ctrl[slot] = (int8_t) (h & 0x7f); \
+            map->entries[slot] = old.entries[i]; \
+        } \
+        free(old.ctrl); \
+        free(old.entries); \
+    } \
+    \
+    /* Returns the entry of key, adding it with a zeroed value if it is */ \
+    /* new. *existed, when not NULL, tells which happened. */ \
+    static inline Name##Entry* prefix##_emplace(Name* map, K key, int* existed){ \
+        Name##Entry* entry = prefix##_find(map, key); \
+        if(existed != NULL) *existed = entry != NULL; \
+        if(entry != NULL) return entry; \
+        \
+        /* At most 7/8 of the slots are taken, so every probe ends */ \
+        if((map->count + map->deleted + 1) * 8 > map->capacity * 7) prefix##__rehash(map); \
+        \
+        uint64_t h = hash(key); \
+        size_t slot = prefix##__free_slot(map, h); \
+        if(map->ctrl[slot] == CLIB_HASHMAP_DELETED) map->deleted--; \
+        map->ctrl[slot] = (int8_t) (h & 0x7f); \
+        map->count++; \
+        \
+        entry = &map->entries[slot]; \
+        memset(entry, 0, sizeof(*entry)); \
+        entry->key = key; \
+        return entry; \
+    } \
+    \
+    static inline V* prefix##_put(Name* map, K key, V value){ \
+        Name##Entry* entry = prefix##_emplace(map, key, NULL); \
+        entry->value = value; \
+        return &entry->value; \
+    } \
+    \
+    static inline int prefix##_remove(Name* map, K key){ \
+        Name##Entry* entry = prefix##_find(map, key); \
+        if(entry == NULL) return false; \
+        \
+        /* No probe has gone past a group that still has an empty slot, */ \
+        /* so the slot can become empty instead of deleted */ \
+        size_t slot = entry - map->entries; \
+        const int8_t* group = map->ctrl + slot / CLIB_HASHMAP_GROUP * CLIB_HASHMAP_GROUP; \
+        if(clib__group_match(group, CLIB_HASHMAP_EMPTY)){ \
+            map->ctrl[slot] = CLIB_HASHMAP_EMPTY; \
+        } else { \
+            map->ctrl[slot] = CLIB_HASHMAP_DELETED; \
+            map->deleted++; \
+        } \
+        map->count--; \
+        return true; \
+    } \
+    \
+    /* The first taken slot from index on, or map->capacity */ \
+    static inline size_t prefix##_next(const Name* map, size_t index){ \
+        while(index < map->capacity && map->ctrl[index] < 0) index++; \
+        return index; \
+    }
+
+#define CLIB_HASHMAP(Name, prefix, K, V, hash, equal) \
+    CLIB_HASHMAP_TYPE(Name, K, V) \
+    CLIB_HASHMAP_IMPL(Name, prefix, K, V, hash, equal)
+
+// Copies each distinct string once into an arena and numbers it. IDs start
+// at 1 and stay valid, as do the interned strings, until the interner is
+// freed, so strings can be compared by ID.
+#define CLIB_INTERN_NONE 0
+#define CLIB_INTERN_CHUNK (64 * 1024)
+
+CLIB_HASHMAP_TYPE(ClibInternMap, CstrView, uint32_t)
+
+typedef struct {
+    ClibInternMap map;
+    CstrView* strings; // by ID
+    uint32_t count;
+    uint32_t capacity;
+    char* chunk; // the arena: chunks linked through their first bytes
+    size_t chunk_used;
+    size_t chunk_size;
+} ClibInterner;
+
+CLIBAPI void clib_interner_init(ClibInterner* interner);
+CLIBAPI void clib_interner_free(ClibInterner* interner);
+CLIBAPI uint32_t clib_intern(ClibInterner* interner, CstrView text);
+CLIBAPI uint32_t clib_intern_find(const ClibInterner* interner, CstrView text);
+
+// The interned text, NUL-terminated
+static inline CstrView clib_interned(const ClibInterner* interner, uint32_t id){
+    assert(id > 0 && id <= interner->count);
+    return interner->strings[id];
+}
+
+// SYSTEM (environment)
+// A ClibEnv is an immutable copy of an environment, hashed by name, that
+// any number of threads can read. Snapshots are reference counted and
+// freed with their last clib_env_release. clib_env_current is the one of
+// the process: it is copied from environ on first use and again after
+// clib_set_env, clib_unset_env or clib_env_refresh, while readers keep the
+// one they hold. clib_get_env reads it too, so changes made with setenv
+// directly are only seen after clib_env_refresh; getenv is the way around
+// that, but it races clib_set_env on other threads.
+#ifndef _WIN32
+CLIB_HASHMAP_TYPE(ClibEnvMap, CstrView, Cstr)
+
+typedef struct {
+    _Atomic size_t refs;
+    ClibEnvMap map; // name -> value, both in `block`
+    char* block; // the "NAME=value" strings
+    char** envp; // NULL-terminated, for execve and posix_spawn
+    size_t count;
+} ClibEnv;
+
+// Changes to a base snapshot, which is shared rather than copied. The
+// changes are kept as "NAME=value" strings; an unset name has a NULL value.
+typedef struct {
+    const ClibEnv* base;
+    ClibEnvMap changes;
+} ClibEnvOverlay;
+
+CLIBAPI const ClibEnv* clib_env_current();
+CLIBAPI void clib_env_refresh();
+CLIBAPI ClibEnv* clib_env_from(char* const* vars);
+CLIBAPI const ClibEnv* clib_env_retain(const ClibEnv* env);
+CLIBAPI void clib_env_release(const ClibEnv* env);
+CLIBAPI Cstr clib_env_get(const ClibEnv* env, Cstr name);
+CLIBAPI void clib_env_overlay_init(ClibEnvOverlay* overlay, const ClibEnv* base);
+CLIBAPI void clib_env_overlay_free(ClibEnvOverlay* overlay);
+CLIBAPI void clib_env_overlay_set(ClibEnvOverlay* overlay, Cstr name, Cstr value);
+CLIBAPI void clib_env_overlay_unset(ClibEnvOverlay* overlay, Cstr name);
+CLIBAPI Cstr clib_env_overlay_get(const ClibEnvOverlay* overlay, Cstr name);
+CLIBAPI ClibEnv* clib_env_overlay_freeze(const ClibEnvOverlay* overlay);
+
+static inline char* const* clib_env_envp(const ClibEnv* env){
+    return env->envp;
+}
+#endif
+
 // CLI
 CLIBAPI char* clib_shift_args(int *argc, char ***argv);
 CLIBAPI CliArg* clib_create_argument(char abr, Cstr full, Cstr help, size_t argument_required);
@@ -189,6 +785,12 @@ CLIBAPI CliArguments clib_make_cli_arguments(size_t capacity, CliArg* first, ...
 CLIBAPI struct option* clib_get_options(CliArguments args);
 CLIBAPI char* clib_generate_cli_format_string(CliArguments args);
 CLIBAPI void clib_cli_help(CliArguments args, Cstr usage, Cstr footer);
+CLIBAPI int clib_opt_parser_init(ClibOptParser* parser, const ClibOption* options, size_t count);
+CLIBAPI const ClibOption* clib_opt_find_long(const ClibOptParser* parser, Cstr name, size_t length);
+CLIBAPI int clib_opt_parse(const ClibOptParser* parser, int argc, char** argv, void* out);
+CLIBAPI void clib_opt_help(const ClibOption* options, size_t count, Cstr usage, Cstr footer);
+CLIBAPI void clib_command_help(const ClibCommand** path, size_t depth);
+CLIBAPI int clib_command_dispatch(const ClibCommand* root, int argc, char** argv, void* ctx);
 
 // LOGGING
 #define HANDLE_ERROR(msg) \
@@ -206,10 +808,31 @@ typedef enum {
     CLIB_PANIC,
 } ClibLog;
 
+// Optional per-line metadata, selected once with clib_log_init
+typedef enum {
+    CLIB_LOG_TIMESTAMP = 1 << 0, // 2024-06-26 12:00:00.000000
+    CLIB_LOG_MONOTONIC = 1 << 1, // [1234.567890]
+    CLIB_LOG_TID       = 1 << 2, // (4242)
+    CLIB_LOG_LOCATION  = 1 << 3, // file.c:12:
+} ClibLogPrefix;
+
+#define CLIB_LOG_PREFIX_MAX 512
+
+CLIBAPI void clib_log_init(int prefix_flags);
+CLIBAPI void clib_log_prefix(FILE* stream, Cstr file, int line);
 CLIBAPI void clib_log(int log_level, char* format, ...);
+// file can be NULL when the location is not known
+CLIBAPI void clib_log_at(Cstr file, int line, int log_level, char* format, ...);
+
+// clib_log with the location of the call
+#define CLIB_LOG(log_level, format, ...) \
+    clib_log_at(__FILE__, __LINE__, log_level, format, ##__VA_ARGS__)
 
 #define LOG(stream, type, format, ...) \
     do { \
+        CLIB_PROFILE_ZONE("LOG"); \
+        CLIB_METRIC_ADD(CLIB_METRIC_LOG_LINES, 1); \
+        clib_log_prefix(stream, __FILE__, __LINE__); \
         fprintf(stream, "[%s] ", type); \
         fprintf(stream, format, ##__VA_ARGS__); \
         fprintf(stream, "\n"); \
@@ -243,18 +866,142 @@ CLIBAPI void clib_log(int log_level, char* format, ...);
         expr;                         \
     } while(0)
 
+// Rate-limited and sampled logging
+// Every call site owns a static ClibLogSite. A suppressed call only loads
+// from it and stores to it, without locked instructions. The number of
+// skipped lines is reported with the next line that gets through, or from
+// a suppressed call once CLIB_LOG_SUMMARY_MS passed without one (the count
+// is approximate under heavy contention).
+#ifndef CLIB_LOG_SUMMARY_MS
+    #define CLIB_LOG_SUMMARY_MS 1000
+#endif
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t suppressed;
+    _Atomic int64_t next_us;
+    _Atomic int64_t summary_us; // when the suppressed lines are due to be reported
+} ClibLogSite;
+
+CLIBAPI int64_t clib_log_now_us();
+CLIBAPI void clib_log_site_suppress(ClibLogSite* site);
+CLIBAPI uint64_t clib_log_site_take_suppressed(ClibLogSite* site);
+CLIBAPI int clib_log_site_summary_due(ClibLogSite* site);
+CLIBAPI int clib_log_site_every_us(ClibLogSite* site, int64_t interval_us);
+CLIBAPI int clib_log_site_rate(ClibLogSite* site, double per_second, int64_t burst);
+
+#define CLIB__LOG_SITE_EMIT(site, stream, type, format, ...) \
+    do { \
+        uint64_t clib__suppressed = clib_log_site_take_suppressed(site); \
+        if(clib__suppressed) \
+            LOG(stream, type, "suppressed %llu messages", (unsigned long long) clib__suppressed); \
+        LOG(stream, type, format, ##__VA_ARGS__); \
+    } while(0)
+
+#define CLIB__LOG_SITE_SUMMARY(site, stream, type) \
+    do { \
+        if(clib_log_site_summary_due(site)) { \
+            uint64_t clib__suppressed = clib_log_site_take_suppressed(site); \
+            if(clib__suppressed) \
+                LOG(stream, type, "suppressed %llu messages", (unsigned long long) clib__suppressed); \
+        } \
+    } while(0)
+
+// n of 0 or 1 logs every line
+#define LOG_EVERY_N(stream, type, n, format, ...) \
+    do { \
+        static ClibLogSite clib__site; \
+        uint64_t clib__i = atomic_load_explicit(&clib__site.count, memory_order_relaxed); \
+        atomic_store_explicit(&clib__site.count, clib__i + 1, memory_order_relaxed); \
+        if((n) <= 1 || clib__i % (uint64_t)(n) == 0) { \
+            CLIB__LOG_SITE_EMIT(&clib__site, stream, type, format, ##__VA_ARGS__); \
+        } else { \
+            clib_log_site_suppress(&clib__site); \
+            CLIB__LOG_SITE_SUMMARY(&clib__site, stream, type); \
+        } \
+    } while(0)
+
+#define LOG_FIRST_N(stream, type, n, format, ...) \
+    do { \
+        static ClibLogSite clib__site; \
+        if(atomic_load_explicit(&clib__site.count, memory_order_relaxed) < (uint64_t)(n)) { \
+            uint64_t clib__i = atomic_fetch_add_explicit(&clib__site.count, 1, memory_order_relaxed); \
+            if(clib__i < (uint64_t)(n)) { \
+                LOG(stream, type, format, ##__VA_ARGS__); \
+                if(clib__i + 1 == (uint64_t)(n)) \
+                    LOG(stream, type, "reached %llu messages, suppressing the rest", (unsigned long long)(n)); \
+                break; \
+            } \
+        } \
+        CLIB_METRIC_ADD(CLIB_METRIC_LOG_DROPPED, 1); \
+    } while(0)
+
+#define LOG_EVERY_MS(stream, type, ms, format, ...) \
+    do { \
+        static ClibLogSite clib__site; \
+        if(clib_log_site_every_us(&clib__site, (int64_t)(ms) * 1000)) \
+            CLIB__LOG_SITE_EMIT(&clib__site, stream, type, format, ##__VA_ARGS__); \
+        else \
+            CLIB__LOG_SITE_SUMMARY(&clib__site, stream, type); \
+    } while(0)
+
+// Token bucket: `per_second` lines on average, bursts of up to `burst`
+#define LOG_RATE_LIMITED(stream, type, per_second, burst, format, ...) \
+    do { \
+        static ClibLogSite clib__site; \
+        if(clib_log_site_rate(&clib__site, (per_second), (burst))) \
+            CLIB__LOG_SITE_EMIT(&clib__site, stream, type, format, ##__VA_ARGS__); \
+        else \
+            CLIB__LOG_SITE_SUMMARY(&clib__site, stream, type); \
+    } while(0)
+
+#define INFO_EVERY_N(n, format, ...) LOG_EVERY_N(stdout, "INFO", n, format, ##__VA_ARGS__)
+#define WARN_EVERY_N(n, format, ...) LOG_EVERY_N(stderr, "WARN", n, format, ##__VA_ARGS__)
+#define ERRO_EVERY_N(n, format, ...) LOG_EVERY_N(stderr, "ERRO", n, format, ##__VA_ARGS__)
+
+#define INFO_FIRST_N(n, format, ...) LOG_FIRST_N(stdout, "INFO", n, format, ##__VA_ARGS__)
+#define WARN_FIRST_N(n, format, ...) LOG_FIRST_N(stderr, "WARN", n, format, ##__VA_ARGS__)
+#define ERRO_FIRST_N(n, format, ...) LOG_FIRST_N(stderr, "ERRO", n, format, ##__VA_ARGS__)
+
+#define INFO_EVERY_MS(ms, format, ...) LOG_EVERY_MS(stdout, "INFO", ms, format, ##__VA_ARGS__)
+#define WARN_EVERY_MS(ms, format, ...) LOG_EVERY_MS(stderr, "WARN", ms, format, ##__VA_ARGS__)
+#define ERRO_EVERY_MS(ms, format, ...) LOG_EVERY_MS(stderr, "ERRO", ms, format, ##__VA_ARGS__)
+
+#define INFO_RATE_LIMITED(per_second, burst, format, ...) \
+    LOG_RATE_LIMITED(stdout, "INFO", per_second, burst, format, ##__VA_ARGS__)
+#define WARN_RATE_LIMITED(per_second, burst, format, ...) \
+    LOG_RATE_LIMITED(stderr, "WARN", per_second, burst, format, ##__VA_ARGS__)
+#define ERRO_RATE_LIMITED(per_second, burst, format, ...) \
+    LOG_RATE_LIMITED(stderr, "ERRO", per_second, burst, format, ##__VA_ARGS__)
+
+#ifdef DEBUG
+    #define DEBU_EVERY_N(n, format, ...) LOG_EVERY_N(stderr, "DEBU", n, format, ##__VA_ARGS__)
+    #define DEBU_FIRST_N(n, format, ...) LOG_FIRST_N(stderr, "DEBU", n, format, ##__VA_ARGS__)
+    #define DEBU_EVERY_MS(ms, format, ...) LOG_EVERY_MS(stderr, "DEBU", ms, format, ##__VA_ARGS__)
+    #define DEBU_RATE_LIMITED(per_second, burst, format, ...) \
+        LOG_RATE_LIMITED(stderr, "DEBU", per_second, burst, format, ##__VA_ARGS__)
+#else
+    #define DEBU_EVERY_N(n, format, ...)
+    #define DEBU_FIRST_N(n, format, ...)
+    #define DEBU_EVERY_MS(ms, format, ...)
+    #define DEBU_RATE_LIMITED(per_second, burst, format, ...)
+#endif // DEBUG
+
 // MENUS
 #ifdef _WIN32
     #include <conio.h>
 #else
     #include <termios.h>
     #include <unistd.h>
-
-    int _getch();
+    #include <poll.h>
+    #include <signal.h>
+    #include <fcntl.h>
 #endif
 
-// TODO: Add more keys
+// Printable bytes are their own key. Keys without a byte of their own
+// start at 256, and modifiers are or-ed into the key.
 typedef enum {
+    CLIB_KEY_NONE = -2, // nothing arrived before the timeout, or end of input
     CLIB_KEY_UNKNOWN = -1,
     CLIB_KEY_ENTER = 10,
     CLIB_KEY_BACKSPACE = 127,
@@ -323,13 +1070,38 @@ typedef enum {
     CLIB_KEY_x = 'x',
     CLIB_KEY_y = 'y',
     CLIB_KEY_z = 'z',
-    // Defined later
-    CLIB_KEY_ARROW_UP,
+    CLIB_KEY_ARROW_UP = 256,
     CLIB_KEY_ARROW_DOWN,
     CLIB_KEY_ARROW_LEFT,
-    CLIB_KEY_ARROW_RIGHT
+    CLIB_KEY_ARROW_RIGHT,
+    CLIB_KEY_HOME,
+    CLIB_KEY_END,
+    CLIB_KEY_PAGE_UP,
+    CLIB_KEY_PAGE_DOWN,
+    CLIB_KEY_INSERT,
+    CLIB_KEY_DELETE,
+    CLIB_KEY_F1,
+    CLIB_KEY_F2,
+    CLIB_KEY_F3,
+    CLIB_KEY_F4,
+    CLIB_KEY_F5,
+    CLIB_KEY_F6,
+    CLIB_KEY_F7,
+    CLIB_KEY_F8,
+    CLIB_KEY_F9,
+    CLIB_KEY_F10,
+    CLIB_KEY_F11,
+    CLIB_KEY_F12,
+    // Bracketed paste: the keys in between were pasted, not typed
+    CLIB_KEY_PASTE_BEGIN,
+    CLIB_KEY_PASTE_END,
 } ClibKey;
 
+#define CLIB_KEY_MOD_SHIFT (1 << 12)
+#define CLIB_KEY_MOD_ALT (1 << 13)
+#define CLIB_KEY_MOD_CTRL (1 << 14)
+#define CLIB_KEY_WITHOUT_MODS(key) ((key) < 0 ? (key) : (key) & 0xfff)
+
 typedef void (*ClibPrintOptionFunc)(Cstr option, int is_selected, int color);
 CLIBAPI void clib_default_print_option(Cstr option, int is_selected, int color);
 CLIBAPI void clib_arrow_print_option(Cstr option, int is_selected, int color);
@@ -337,36 +1109,653 @@ CLIBAPI void clib_brackets_print_option(Cstr option, int is_selected, int color)
 CLIBAPI void clib_enable_input_buffering();
 CLIBAPI void clib_disable_input_buffering();
 CLIBAPI int clib_getch();
+
+#ifndef _WIN32
+// Input session: the terminal stays in raw mode from begin to end, and
+// keys are decoded from bytes read in bulk. A lone ESC is told apart from
+// an escape sequence by waiting escape_timeout_ms for the rest of it.
+#define CLIB_INPUT_BUFFER 256
+#define CLIB_INPUT_ESCAPE_TIMEOUT_MS 25
+
+typedef struct {
+    int fd;
+    int active;
+    int is_tty;
+    int bracketed_paste;
+    int pasting; // between CLIB_KEY_PASTE_BEGIN and CLIB_KEY_PASTE_END
+    int escape_timeout_ms; // 0 uses CLIB_INPUT_ESCAPE_TIMEOUT_MS
+    struct termios saved;
+    unsigned char buffer[CLIB_INPUT_BUFFER];
+    size_t start;
+    size_t length;
+} ClibInput;
+
+CLIBAPI void clib_input_begin(ClibInput* input, int fd, int bracketed_paste);
+CLIBAPI void clib_input_end(ClibInput* input);
+CLIBAPI int clib_input_read(ClibInput* input, int timeout_ms);
+#endif
+
 CLIBAPI int clib_menu(Cstr title, int color, ClibPrintOptionFunc print_option, Cstr first_option, ...);
 
+// Menu over an array of options or a callback. Only the visible rows are
+// drawn, so it works for very large option sets. With filter set, typing
+// narrows the options to those containing the query as a subsequence
+// (case-insensitive). get_item must return the same string for an index
+// for as long as the menu runs.
+typedef Cstr (*ClibMenuItemFunc)(size_t index, void* ctx);
+
+#define CLIB_MENU_QUERY_MAX 64
+
+typedef struct {
+    Cstr title; // can be NULL
+    int color;
+    ClibPrintOptionFunc print_option;
+    Cstr* items; // count options, or NULL to use get_item
+    ClibMenuItemFunc get_item;
+    void* ctx;
+    size_t count;
+    int visible_rows; // 0 fits the menu in the terminal
+    int filter;
+} ClibMenuConfig;
+
+CLIBAPI long clib_menu_select(const ClibMenuConfig* config);
+
+// Screen model: the cells of an inline region of the terminal, for the
+// frame on screen and the one being drawn. Presenting sends only the
+// cells that changed between the two.
+#define CLIB_COLOR_DEFAULT -1
+#define CLIB_COLOR_RGB(r, g, b) ((1 << 24) | ((r) << 16) | ((g) << 8) | (b))
+
+typedef enum {
+    CLIB_ATTR_BOLD = 1 << 0,
+    CLIB_ATTR_ITALIC = 1 << 1,
+    CLIB_ATTR_UNDERLINE = 1 << 2,
+} ClibAttr;
+
+typedef struct {
+    char glyph[4]; // one UTF-8 character, NUL-padded
+    int32_t fg; // CLIB_COLOR_DEFAULT, 0-255 or CLIB_COLOR_RGB
+    int32_t bg;
+    uint8_t attrs;
+} ClibCell;
+
+typedef struct {
+    int width;
+    int height;
+    ClibCell* front;
+    ClibCell* back;
+    int cursor_row; // where the terminal cursor is, relative to the region
+    int cursor_col;
+    int presented;
+    ClibTermBuf out;
+} ClibScreen;
+
+CLIBAPI void clib_screen_init(ClibScreen* screen, int width, int height);
+CLIBAPI void clib_screen_free(ClibScreen* screen);
+CLIBAPI void clib_screen_clear(ClibScreen* screen);
+CLIBAPI int clib_screen_put(ClibScreen* screen, int row, int col, Cstr text, size_t length);
+CLIBAPI void clib_screen_present(ClibScreen* screen);
+CLIBAPI void clib_screen_release(ClibScreen* screen);
+
+#if defined(CLIB_MENUS) && !defined(_WIN32)
+// Event loop: waits on the keyboard, terminal resizes, timers and any
+// other file descriptors at once and calls back for each event. Only one
+// loop can run at a time, since resizes arrive through a signal. Like the
+// rest of the terminal input, it needs CLIB_MENUS.
+#define CLIB_LOOP_MAX_TIMERS 32
+#define CLIB_LOOP_MAX_FDS 32
+
+typedef struct ClibLoop ClibLoop;
+typedef void (*ClibLoopKeyFunc)(ClibLoop* loop, int key, void* ctx);
+typedef void (*ClibLoopResizeFunc)(ClibLoop* loop, int columns, int rows, void* ctx);
+typedef void (*ClibLoopTimerFunc)(ClibLoop* loop, void* ctx);
+typedef void (*ClibLoopFdFunc)(ClibLoop* loop, int fd, short revents, void* ctx);
+
+typedef struct {
+    int64_t due_ms;
+    int64_t interval_ms; // 0 fires once
+    ClibLoopTimerFunc func;
+    void* ctx;
+    int active;
+} ClibLoopTimer;
+
+typedef struct {
+    int fd; // -1 for a free slot
+    short events;
+    ClibLoopFdFunc func;
+    void* ctx;
+} ClibLoopFd;
+
+struct ClibLoop {
+    ClibInput input;
+    int input_open;
+    ClibLoopKeyFunc on_key;
+    void* key_ctx;
+    ClibLoopResizeFunc on_resize;
+    void* resize_ctx;
+    ClibLoopTimer timers[CLIB_LOOP_MAX_TIMERS];
+    ClibLoopFd fds[CLIB_LOOP_MAX_FDS];
+    int running;
+};
+
+CLIBAPI int clib_loop_init(ClibLoop* loop);
+CLIBAPI void clib_loop_free(ClibLoop* loop);
+CLIBAPI void clib_loop_on_key(ClibLoop* loop, ClibLoopKeyFunc func, void* ctx);
+CLIBAPI void clib_loop_on_resize(ClibLoop* loop, ClibLoopResizeFunc func, void* ctx);
+CLIBAPI int clib_loop_add_timer(ClibLoop* loop, int64_t delay_ms, int64_t interval_ms, ClibLoopTimerFunc func, void* ctx);
+CLIBAPI void clib_loop_remove_timer(ClibLoop* loop, int timer);
+CLIBAPI int clib_loop_add_fd(ClibLoop* loop, int fd, short events, ClibLoopFdFunc func, void* ctx);
+CLIBAPI void clib_loop_remove_fd(ClibLoop* loop, int fd);
+CLIBAPI int clib_loop_step(ClibLoop* loop, int timeout_ms);
+CLIBAPI int clib_loop_run(ClibLoop* loop);
+CLIBAPI void clib_loop_stop(ClibLoop* loop);
+#endif // CLIB_MENUS
+
+// PROFILE
+// The zone macros compile to nothing unless CLIB_PROFILE is defined
+#define CLIB__CONCAT_(a, b) a##b
+#define CLIB__CONCAT(a, b) CLIB__CONCAT_(a, b)
+
+#ifdef CLIB_PROFILE
+#ifndef CLIB_PROFILE_CAPACITY
+    #define CLIB_PROFILE_CAPACITY (1 << 16) // events per thread
+#endif
+
+typedef enum {
+    CLIB_PROFILE_EVENT_ZONE,
+    CLIB_PROFILE_EVENT_COUNTER,
+} ClibProfileEventKind;
+
+typedef struct {
+    Cstr name;
+    uint64_t timestamp_ns;
+    union {
+        uint64_t duration_ns;
+        double value;
+    };
+    ClibProfileEventKind kind;
+} ClibProfileEvent;
+
+// Only the owning thread writes to its buffer. It publishes events by
+// storing `count` with release order, which is what the exporter reads.
+typedef struct ClibProfileThread {
+    struct ClibProfileThread* next;
+    uint64_t tid;
+    _Atomic size_t count;
+    _Atomic size_t dropped;
+    ClibProfileEvent events[];
+} ClibProfileThread;
+
+typedef struct {
+    Cstr name;
+    uint64_t begin_ns;
+} ClibProfileZone;
+
+CLIBAPI void clib_profile_init(Cstr path);
+CLIBAPI uint64_t clib_profile_now_ns();
+CLIBAPI ClibProfileZone clib_profile_zone_begin(Cstr name);
+CLIBAPI void clib_profile_zone_end(ClibProfileZone* zone);
+CLIBAPI void clib_profile_counter(Cstr name, double value);
+CLIBAPI int clib_profile_export(Cstr path);
+
+#define CLIB_PROFILE_ZONE(name) \
+    ClibProfileZone CLIB__CONCAT(clib__zone_, __LINE__) \
+        __attribute__((cleanup(clib_profile_zone_end))) = clib_profile_zone_begin(name)
+#define CLIB_PROFILE_COUNTER(name, value) clib_profile_counter(name, value)
+#else
+#define CLIB_PROFILE_ZONE(name)
+#define CLIB_PROFILE_COUNTER(name, value)
+#endif // CLIB_PROFILE
+
+#define CLIB_PROFILE_FUNCTION() CLIB_PROFILE_ZONE(__func__)
+
+// CONFIG
+#ifdef CLIB_CONFIG
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+#endif
+
+// Later sources win
+typedef enum {
+    CLIB_CONFIG_UNSET,
+    CLIB_CONFIG_DEFAULT,
+    CLIB_CONFIG_FILE,
+    CLIB_CONFIG_ENV,
+    CLIB_CONFIG_CLI,
+} ClibConfigSource;
+
+// Binds a command line option to an environment variable and a key of the
+// config file. Any of them can be left out.
+typedef struct {
+    char abr;
+    Cstr full;
+    Cstr help;
+    Cstr env;      // e.g. "APP_JOBS"
+    Cstr key;      // e.g. "build.jobs" for `jobs` under `[build]`
+    Cstr fallback; // default value
+} ClibConfigVar;
+
+// A loaded file, which the values from it point into
+typedef struct {
+    char* data;
+    size_t size;
+    int mapped;
+} ClibConfigFile;
+
+typedef struct {
+    const ClibConfigVar* vars;
+    size_t count;
+    Cstr* values; // resolved values, indexed like `vars`
+    ClibConfigSource* sources;
+    ClibInterner keys; // of the config file, so lines are matched by ID
+    uint32_t* key_ids; // indexed like `vars`
+    ClibConfigFile* files; // every file loaded, kept until clib_config_clean
+    size_t file_count;
+    const ClibEnv* env; // taken by the first clib_config_resolve, values point into it
+} ClibConfig;
+
+CLIBAPI void clib_config_init(ClibConfig* config, const ClibConfigVar* vars, size_t count);
+CLIBAPI void clib_config_clean(ClibConfig* config);
+CLIBAPI void clib_config_set(ClibConfig* config, size_t index, Cstr value, ClibConfigSource source);
+CLIBAPI int clib_config_load_file(ClibConfig* config, Cstr path);
+CLIBAPI int clib_config_parse_args(ClibConfig* config, int argc, char** argv);
+CLIBAPI void clib_config_resolve(ClibConfig* config);
+CLIBAPI void clib_config_help(const ClibConfig* config, Cstr usage, Cstr footer);
+
+static inline Cstr clib_config_get(const ClibConfig* config, size_t index){
+    return config->values[index];
+}
+
+static inline ClibConfigSource clib_config_source(const ClibConfig* config, size_t index){
+    return config->sources[index];
+}
+#endif // CLIB_CONFIG
+
+// BENCH
+#ifdef CLIB_BENCH
+#if defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+#endif
+
+// Keeps the compiler from discarding `value` or the stores that produced it
+#define CLIB_DO_NOT_OPTIMIZE(value) __asm__ volatile("" : : "r,m"(value) : "memory")
+#define CLIB_CLOBBER_MEMORY() __asm__ volatile("" : : : "memory")
+
+typedef enum {
+    CLIB_BENCH_TEXT,
+    CLIB_BENCH_CSV,
+    CLIB_BENCH_JSON,
+} ClibBenchFormat;
+
+typedef struct {
+    uint64_t warmup_ms; // default: 100
+    uint64_t sample_ms; // target duration of one sample, default: 10
+    size_t samples;     // default: 30
+} ClibBenchConfig;
+
+typedef struct {
+    Cstr name;
+    size_t size; // input size the case was run with, 0 if it has none
+    uint64_t iterations; // per sample
+    size_t samples;
+    double min_ns;
+    double median_ns;
+    double mean_ns;
+    double p99_ns;
+    double max_ns;
+    double stddev_ns;
+    double median_cycles; // 0 where there is no cycle counter
+} ClibBenchResult;
+
+typedef struct {
+    ClibBenchConfig config;
+    ClibBenchResult* results;
+    size_t count;
+    size_t capacity;
+} ClibBench;
+
+// Runs the measured code `iterations` times
+typedef void (*ClibBenchFunc)(void* ctx, uint64_t iterations);
+
+CLIBAPI uint64_t clib_bench_now_ns();
+CLIBAPI uint64_t clib_bench_cycles();
+CLIBAPI ClibBench clib_bench_make(ClibBenchConfig config);
+CLIBAPI void clib_bench_clean(ClibBench* bench);
+CLIBAPI ClibBenchResult clib_bench_run(ClibBench* bench, Cstr name, size_t size, ClibBenchFunc func, void* ctx);
+CLIBAPI void clib_bench_report(ClibBench bench, ClibBenchFormat format, FILE* stream);
+CLIBAPI ClibBenchFormat clib_bench_format_from_args(int argc, char** argv);
+#endif // CLIB_BENCH
+
+// PROGRESS
+#ifdef CLIB_PROGRESS
+#include <pthread.h>
+
+#define CLIB_PROGRESS_MAX_BARS 16
+#define CLIB_PROGRESS_HZ 15
+
+// Workers only touch `done` and `total`. Each bar has its own cache line,
+// so workers of different bars do not slow each other down.
+typedef struct {
+    _Alignas(64) _Atomic uint64_t done;
+    _Atomic uint64_t total; // 0 when unknown
+    char label[32];
+    // Owned by the renderer
+    uint64_t last_ns;
+    uint64_t last_done;
+    double rate; // smoothed items per second
+} ClibProgressBar;
+
+typedef struct {
+    ClibProgressBar bars[CLIB_PROGRESS_MAX_BARS];
+    _Atomic size_t count;
+    int enabled; // stdout is a terminal
+    int hz;
+    _Atomic int running;
+    pthread_t thread;
+    size_t drawn; // lines on screen
+    ClibTermBuf out;
+} ClibProgress;
+
+CLIBAPI void clib_progress_init(ClibProgress* progress, int hz);
+CLIBAPI ClibProgressBar* clib_progress_add_bar(ClibProgress* progress, Cstr label, uint64_t total);
+CLIBAPI void clib_progress_render(ClibProgress* progress);
+CLIBAPI int clib_progress_start(ClibProgress* progress);
+CLIBAPI void clib_progress_stop(ClibProgress* progress);
+
+// Cheap enough for hot loops, though adding in batches is cheaper still
+static inline void clib_progress_advance(ClibProgressBar* bar, uint64_t count){
+    atomic_fetch_add_explicit(&bar->done, count, memory_order_relaxed);
+}
+
+static inline void clib_progress_set_total(ClibProgressBar* bar, uint64_t total){
+    atomic_store_explicit(&bar->total, total, memory_order_relaxed);
+}
+#endif // CLIB_PROGRESS
+
+// WATCHER
+#ifdef CLIB_WATCHER
+#ifndef __linux__
+    #error "CLIB_WATCHER is built on inotify, which only Linux has"
+#endif
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#define CLIB_WATCHER_DEBOUNCE_MS 50
+
+#define CLIB_WATCH_CREATED (1 << 0) // also a file renamed into place
+#define CLIB_WATCH_MODIFIED (1 << 1)
+#define CLIB_WATCH_DELETED (1 << 2) // also a file renamed away
+
+typedef void (*ClibWatcherFunc)(Cstr path, int changes, void* ctx);
+
+// A watched directory. Files are watched through their directory, so one
+// that an editor replaces with a rename is still followed.
+typedef struct {
+    char* path;
+    int recursive;
+    int whole; // every entry counts, not only `names`
+    char** names;
+    size_t name_count;
+} ClibWatch;
+
+CLIB_HASHMAP_TYPE(ClibWatchMap, uint64_t, ClibWatch) // by watch descriptor
+CLIB_HASHMAP_TYPE(ClibWatchChanges, CstrView, int) // path -> CLIB_WATCH_* bits
+
+// Changes that arrive within debounce_ms of the first one are merged and
+// reported together, once per path. Report them by attaching the watcher
+// to a ClibLoop, or by polling clib_watcher_fd for up to
+// clib_watcher_timeout ms and calling clib_watcher_process.
+typedef struct {
+    int fd;
+    int debounce_ms;
+    ClibWatcherFunc func;
+    void* ctx;
+    ClibWatchMap watches;
+    ClibWatchChanges pending;
+    int64_t due_ms; // when `pending` is reported, 0 while it is empty
+#ifdef CLIB_MENUS
+    ClibLoop* loop;
+    int timer;
+#endif
+} ClibWatcher;
+
+CLIBAPI int clib_watcher_init(ClibWatcher* watcher, int debounce_ms, ClibWatcherFunc func, void* ctx);
+CLIBAPI void clib_watcher_free(ClibWatcher* watcher);
+CLIBAPI int clib_watcher_add(ClibWatcher* watcher, Cstr path, int recursive);
+CLIBAPI int clib_watcher_timeout(const ClibWatcher* watcher);
+CLIBAPI void clib_watcher_process(ClibWatcher* watcher);
+#ifdef CLIB_MENUS
+CLIBAPI int clib_watcher_attach(ClibWatcher* watcher, ClibLoop* loop);
+#endif
+
+static inline int clib_watcher_fd(const ClibWatcher* watcher){
+    return watcher->fd;
+}
+#endif // CLIB_WATCHER
+
+// CSV
+#ifdef CLIB_CSV
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+#endif
+#include <pthread.h>
+
+#define CLIB_CSV_MAX_THREADS 64
+
+// Reads CSV (or TSV, with '\t') over a buffer without copying it. The text
+// is classified 64 bytes at a time into delimiter, quote and newline
+// bitmasks, so the fields are found without looking at every byte.
+//
+// Fields are views into the buffer. A quoted field loses its quotes, and
+// its doubled quotes are undone in place, which is why the buffer has to
+// be writable; files are mapped copy-on-write. "\r\n" line ends are
+// accepted and empty lines are skipped.
+typedef struct {
+    char* data;
+    size_t length;
+    char delimiter;
+    size_t position; // where the next field starts
+    size_t block; // offset of the block `structural` belongs to
+    uint64_t structural; // delimiters and newlines outside quotes, not yet consumed
+    uint64_t inside; // all ones when the last block ended inside quotes
+    CstrView* fields; // of the last record
+    size_t field_count;
+    size_t field_capacity;
+    size_t mapped_size; // nonzero when `data` is a mapping of a file
+} ClibCsv;
+
+typedef void (*ClibCsvChunkFunc)(ClibCsv* chunk, size_t index, void* ctx);
+
+CLIBAPI void clib_csv_init(ClibCsv* csv, char* data, size_t length, char delimiter);
+CLIBAPI int clib_csv_open(ClibCsv* csv, Cstr path, char delimiter);
+CLIBAPI void clib_csv_close(ClibCsv* csv);
+CLIBAPI int clib_csv_next(ClibCsv* csv);
+CLIBAPI size_t clib_csv_split(Cstr data, size_t length, size_t parts, size_t* starts);
+CLIBAPI int clib_csv_parallel(const ClibCsv* csv, size_t threads, ClibCsvChunkFunc func, void* ctx);
+#endif // CLIB_CSV
+
+// METRICS
+// The metric macros compile to nothing unless CLIB_METRICS is defined
+#ifdef CLIB_METRICS
+#ifndef _WIN32
+    #include <sys/socket.h>
+    #include <sys/un.h>
+#endif
+#include <pthread.h>
+
+#ifndef CLIB_METRICS_MAX
+    #define CLIB_METRICS_MAX 64 // the built-in metrics included
+#endif
+#ifndef CLIB_METRICS_SLOTS
+    #define CLIB_METRICS_SLOTS 256 // per thread: 1 per counter, CLIB_METRICS_BUCKETS + 1 per histogram
+#endif
+
+// Histograms count nanoseconds into buckets that end at 1us, 4us, 16us
+// and so on up to 4^12us (about 16.8s), then +Inf
+#define CLIB_METRICS_BUCKETS 14
+
+typedef enum {
+    CLIB_METRIC_COUNTER,
+    CLIB_METRIC_GAUGE,
+    CLIB_METRIC_HISTOGRAM,
+} ClibMetricKind;
+
+typedef struct {
+    Cstr name;
+    Cstr help;
+    ClibMetricKind kind;
+    uint32_t slot; // the first of its shard slots, or its gauge
+} ClibMetric;
+
+// Recorded by the library itself
+enum {
+    CLIB_METRIC_FILE_READ_BYTES,
+    CLIB_METRIC_FILE_WRITTEN_BYTES,
+    CLIB_METRIC_COMMANDS,
+    CLIB_METRIC_COMMAND_SECONDS,
+    CLIB_METRIC_LOG_LINES,
+    CLIB_METRIC_LOG_DROPPED,
+    CLIB__METRIC_BUILTIN_COUNT,
+};
+
+// Counters and histograms live in per-thread shards that only their thread
+// writes, so an update is a plain load and store to a line no other thread
+// touches. Reading sums the shards. A shard outlives its thread and is
+// handed to the next thread that starts, which keeps the totals.
+typedef struct ClibMetricsShard {
+    struct ClibMetricsShard* next;
+    _Atomic int owned;
+    _Atomic uint64_t slots[CLIB_METRICS_SLOTS];
+} __attribute__((aligned(64))) ClibMetricsShard;
+
+typedef struct {
+    int id;
+    uint64_t begin_ns;
+} ClibMetricsTimer;
+
+// Ids come from the registration functions or the CLIB_METRIC_* builtins.
+// Any other id, like the -1 of a failed registration, is ignored.
+CLIBAPI int clib_metrics_counter(Cstr name, Cstr help);
+CLIBAPI int clib_metrics_gauge(Cstr name, Cstr help);
+CLIBAPI int clib_metrics_histogram(Cstr name, Cstr help);
+CLIBAPI uint64_t clib_metrics_now_ns();
+CLIBAPI void clib_metrics_add(int id, uint64_t amount);
+CLIBAPI void clib_metrics_observe(int id, uint64_t ns);
+CLIBAPI void clib_metrics_set(int id, double value);
+CLIBAPI void clib_metrics_gauge_add(int id, double delta);
+CLIBAPI uint64_t clib_metrics_value(int id);
+CLIBAPI double clib_metrics_gauge_value(int id);
+CLIBAPI ClibMetricsTimer clib_metrics_timer_begin(int id);
+CLIBAPI void clib_metrics_timer_end(ClibMetricsTimer* timer);
+CLIBAPI int clib_metrics_write(FILE* file);
+CLIBAPI int clib_metrics_export(Cstr target);
+CLIBAPI int clib_metrics_export_start(Cstr target, int interval_ms);
+CLIBAPI void clib_metrics_export_stop();
+
+#define CLIB_METRIC_ADD(id, amount) clib_metrics_add(id, amount)
+#define CLIB_METRIC_OBSERVE(id, ns) clib_metrics_observe(id, ns)
+#define CLIB_METRIC_TIME(id) \
+    ClibMetricsTimer CLIB__CONCAT(clib__timer_, __LINE__) \
+        __attribute__((cleanup(clib_metrics_timer_end))) = clib_metrics_timer_begin(id)
+#else
+#define CLIB_METRIC_ADD(id, amount)
+#define CLIB_METRIC_OBSERVE(id, ns)
+#define CLIB_METRIC_TIME(id)
+#endif // CLIB_METRICS
+
 // END [DECLARATIONS] END//
 
 // START [IMPLEMENTATIONS] START //
 #ifdef CLIB_IMPLEMENTATION
 
-// Memory leak
+// Short output is formatted once into the stack and copied. Only longer
+// output is measured first.
 CLIBAPI char* clib_format_text(const char *format, ...) {
+    char buffer[CLIB_SCRATCH_SIZE];
     va_list args;
     va_start(args, format);
-    size_t size = vsnprintf(NULL, 0, format, args) + 1; // +1 for the null terminator
+    int length = vsnprintf(buffer, sizeof(buffer), format, args);
     va_end(args);
+    if (length < 0) {
+        return NULL;
+    }
 
-    char* formatted_string = (char*) malloc(size);
+    char* formatted_string = (char*) malloc(length + 1); // +1 for the null terminator
     if (formatted_string == NULL) {
         return NULL;
     }
 
+    if ((size_t) length < sizeof(buffer)) {
+        memcpy(formatted_string, buffer, length + 1);
+        return formatted_string;
+    }
+
     va_start(args, format);
-    vsnprintf(formatted_string, size, format, args);
+    vsnprintf(formatted_string, length + 1, format, args);
     va_end(args);
 
-    formatted_string[size-1] = '\0';
-
     return formatted_string;
 }
 
+typedef struct {
+    char inline_data[CLIB_SCRATCH_SIZE];
+    char* heap; // for output that did not fit, kept for the next time around
+    size_t heap_size;
+} ClibScratch;
+
+static CLIB_THREAD_LOCAL ClibScratch clib__scratch[CLIB_SCRATCH_COUNT];
+static CLIB_THREAD_LOCAL unsigned int clib__scratch_next = 0;
+
+CLIBAPI Cstr clib_vformat_scratch(const char *format, va_list args){
+    ClibScratch* scratch = &clib__scratch[clib__scratch_next];
+    clib__scratch_next = (clib__scratch_next + 1) % CLIB_SCRATCH_COUNT;
+
+    char* buffer = scratch->inline_data;
+    size_t size = sizeof(scratch->inline_data);
+    if(scratch->heap_size > size){
+        buffer = scratch->heap;
+        size = scratch->heap_size;
+    }
+
+    va_list copy;
+    va_copy(copy, args);
+    int length = vsnprintf(buffer, size, format, copy);
+    va_end(copy);
+    if(length < 0) return "";
+    if((size_t) length < size) return buffer;
+
+    scratch->heap = (char*) clib_safe_realloc(scratch->heap, length + 1);
+    scratch->heap_size = length + 1;
+    vsnprintf(scratch->heap, scratch->heap_size, format, args);
+    return scratch->heap;
+}
+
+CLIBAPI Cstr clib_format_scratch(const char *format, ...){
+    va_list args;
+    va_start(args, format);
+    Cstr formatted = clib_vformat_scratch(format, args);
+    va_end(args);
+    return formatted;
+}
+
+// Frees the buffers of the calling thread that outgrew CLIB_SCRATCH_SIZE.
+// Threads that format long scratch text call it before they exit.
+CLIBAPI void clib_scratch_release(){
+    for(size_t i = 0; i < CLIB_SCRATCH_COUNT; ++i){
+        free(clib__scratch[i].heap);
+        clib__scratch[i].heap = NULL;
+        clib__scratch[i].heap_size = 0;
+    }
+}
+
 CLIBAPI CliArg* clib_create_argument(char abr, Cstr full, Cstr help, size_t argument_required) {
     CliArg* arg = (CliArg*) clib_safe_malloc(sizeof(CliArg));
+    arg->full = NULL;
 
     if(full){
         arg->full = (char*) malloc(strlen(full) + 1);
@@ -439,63 +1828,47 @@ CLIBAPI struct option* clib_get_options(CliArguments args) {
         return NULL;
     }
 
-    struct option* options = (struct option*) malloc(sizeof(struct option) * args.count);
+    // getopt_long expects the array to end with an all-zero entry
+    struct option* options = (struct option*) calloc(args.count + 1, sizeof(struct option));
     if (!options) {
         return NULL;
     }
 
+    size_t count = 0;
     for (size_t i = 0; i < args.count; ++i) {
         CliArg* arg = args.args[i];
-        options[i].val = arg->abr;
-        if(arg->full) options[i].name = arg->full;
-        options[i].flag = NULL;
-        options[i].has_arg = arg->argument_required;
+        if(arg->full == NULL) continue;
+
+        options[count].val = arg->abr;
+        options[count].name = arg->full;
+        options[count].flag = NULL;
+        options[count].has_arg = arg->argument_required;
+        count++;
     }
 
     return options;
 }
 
+// Length of "-a --full", or "-a" without a long name
+static size_t clib__arg_length(const CliArg* arg){
+    return arg->full == NULL ? 2 : 5 + strlen(arg->full);
+}
+
 static size_t get_max_length(CliArguments args){
     size_t max_len = 0;
 
     for(size_t i = 0; i < args.count; ++i){
         if(args.args[i] == NULL) continue;
 
-        size_t current_len = 0;
-        if(args.args[i]->full == NULL)
-            current_len = snprintf(NULL, 0, "-%c", args.args[i]->abr);
-        else
-            current_len = snprintf(NULL, 0, "-%c --%s", args.args[i]->abr, args.args[i]->full);
+        size_t current_len = clib__arg_length(args.args[i]);
         if(current_len > max_len) max_len = current_len;
     }
 
     return max_len;
 }
 
-static char* add_spaces(size_t max_len, CliArg* arg){
-    size_t arg_len = 0;
-    if(arg->full == NULL)
-        arg_len = snprintf(NULL, 0, "-%c", arg->abr);
-    else 
-         arg_len = snprintf(NULL, 0, "-%c --%s", arg->abr, arg->full);
-
-    size_t GAP = 4;
-    size_t final_size = max_len - arg_len + GAP + 1; // +1 for '\0'
-    char* spaces = (char*) malloc(final_size);
-    if(spaces == NULL){
-        return NULL;
-    }
-
-    for(size_t i = 0; i < final_size - 1; ++i){
-        spaces[i] = ' ';
-    }
-    spaces[final_size-1] = '\0';
-
-    return spaces;
-}
-
-CLIBAPI void clib_cli_help(CliArguments args, Cstr usage, Cstr footer){
-    if(usage) printf("Usage: %s\n\n", usage);
+CLIBAPI void clib_cli_help(CliArguments args, Cstr usage, Cstr footer){
+    if(usage) printf("Usage: %s\n\n", usage);
 
     size_t max_len = get_max_length(args);
     for(size_t i = 0; i < args.count; ++i){
@@ -512,31 +1885,38 @@ CLIBAPI void clib_cli_help(CliArguments args, Cstr usage, Cstr footer){
                 break;
         }
 
-        char* spaces = add_spaces(max_len, args.args[i]);
-        if(spaces == NULL) return;
+        // The padding is printed as an empty string in a field this wide
+        int spaces = max_len - clib__arg_length(args.args[i]) + 4;
         Cstr arg_required = COLOR_FG(args.args[i]->argument_required + 1);
-        if(args.args[i]->full){
-            printf("-%c --%s%s%s %s[%s]%s\n", 
+        if(args.args[i]->full && args.args[i]->abr == 0){
+            printf("   --%s%*s%s %s[%s]%s\n", 
+                args.args[i]->full,
+                spaces, "",
+                args.args[i]->help,
+                arg_required,
+                has_arg,
+                RESET
+            );
+        } else if(args.args[i]->full){
+            printf("-%c --%s%*s%s %s[%s]%s\n", 
                 args.args[i]->abr, 
                 args.args[i]->full,
-                spaces,
+                spaces, "",
                 args.args[i]->help,
                 arg_required,
                 has_arg,
                 RESET
             );
         } else {
-            printf("-%c%s%s %s[%s]%s\n", 
+            printf("-%c%*s%s %s[%s]%s\n", 
                 args.args[i]->abr, 
-                spaces,
+                spaces, "",
                 args.args[i]->help,
                 arg_required,
                 has_arg,
                 RESET
             );
         }
-        free((char*) arg_required);
-        free(spaces);
     }
     printf("\n");
 
@@ -571,7 +1951,493 @@ CLIBAPI char* clib_generate_cli_format_string(CliArguments args) {
     return fmt;
 }
 
-CLIBAPI void clib_log(int log_level, char* format, ...){
+static uint64_t clib__opt_hash(Cstr name, size_t length){
+    uint64_t hash = 0xcbf29ce484222325ull; // FNV-1a
+    for(size_t i = 0; i < length; ++i){
+        hash ^= (unsigned char) name[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint32_t clib__opt_slot(uint64_t hash, uint32_t displacement, uint32_t mask){
+    uint64_t x = hash + displacement * 0x9e3779b97f4a7c15ull;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return (uint32_t) x & mask;
+}
+
+CLIBAPI int clib_opt_parser_init(ClibOptParser* parser, const ClibOption* options, size_t count){
+    memset(parser, 0, sizeof(*parser));
+    parser->options = options;
+    parser->count = count;
+
+    if(count > CLIB_OPT_MAX){
+        ERRO("Too many options: %zu (max %d)", count, CLIB_OPT_MAX);
+        return -1;
+    }
+
+    size_t long_count = 0;
+    for(size_t i = 0; i < count; ++i){
+        if(options[i].abr){
+            if(parser->shorts[(unsigned char) options[i].abr]){
+                ERRO("Duplicate option: -%c", options[i].abr);
+                return -1;
+            }
+            parser->shorts[(unsigned char) options[i].abr] = (uint8_t) (i + 1);
+        }
+        if(options[i].full) long_count++;
+    }
+
+    uint32_t buckets = 1;
+    while(buckets < long_count) buckets <<= 1;
+    parser->bucket_mask = buckets - 1;
+    parser->slot_mask = 2 * buckets - 1;
+
+    // Group the long options by bucket and place the fullest buckets first
+    uint64_t hashes[CLIB_OPT_MAX];
+    uint8_t sizes[CLIB_OPT_MAX] = {0};
+    for(size_t i = 0; i < count; ++i){
+        if(options[i].full == NULL) continue;
+        hashes[i] = clib__opt_hash(options[i].full, strlen(options[i].full));
+        sizes[hashes[i] & parser->bucket_mask]++;
+    }
+
+    for(size_t placed = 0; placed < buckets; ++placed){
+        uint32_t bucket = 0;
+        for(uint32_t b = 1; b < buckets; ++b){
+            if(sizes[b] > sizes[bucket]) bucket = b;
+        }
+        if(sizes[bucket] == 0) break;
+
+        size_t members[CLIB_OPT_MAX];
+        size_t member_count = 0;
+        for(size_t i = 0; i < count; ++i){
+            if(options[i].full == NULL || (hashes[i] & parser->bucket_mask) != bucket) continue;
+
+            // Equal names share a bucket and could never be separated
+            for(size_t m = 0; m < member_count; ++m){
+                if(hashes[members[m]] == hashes[i] && strcmp(options[members[m]].full, options[i].full) == 0){
+                    ERRO("Duplicate option: --%s", options[i].full);
+                    return -1;
+                }
+            }
+            members[member_count++] = i;
+        }
+
+        uint32_t displacement = 0;
+        for(; displacement <= UINT16_MAX; ++displacement){
+            uint32_t taken[CLIB_OPT_MAX];
+            size_t m = 0;
+            for(; m < member_count; ++m){
+                uint32_t slot = clib__opt_slot(hashes[members[m]], displacement, parser->slot_mask);
+                if(parser->slots[slot]) break;
+
+                size_t t = 0;
+                while(t < m && taken[t] != slot) t++;
+                if(t < m) break;
+                taken[m] = slot;
+            }
+            if(m == member_count) break;
+        }
+        if(displacement > UINT16_MAX){
+            ERRO("Could not build the option hash table");
+            return -1;
+        }
+
+        parser->displacements[bucket] = (uint16_t) displacement;
+        for(size_t m = 0; m < member_count; ++m){
+            uint32_t slot = clib__opt_slot(hashes[members[m]], displacement, parser->slot_mask);
+            parser->slots[slot] = (uint8_t) (members[m] + 1);
+        }
+        sizes[bucket] = 0;
+    }
+
+    return 0;
+}
+
+CLIBAPI const ClibOption* clib_opt_find_long(const ClibOptParser* parser, Cstr name, size_t length){
+    if(parser->count == 0) return NULL;
+
+    uint64_t hash = clib__opt_hash(name, length);
+    uint32_t displacement = parser->displacements[hash & parser->bucket_mask];
+    uint8_t index = parser->slots[clib__opt_slot(hash, displacement, parser->slot_mask)];
+    if(index == 0) return NULL;
+
+    const ClibOption* option = &parser->options[index - 1];
+    if(strncmp(option->full, name, length) != 0 || option->full[length] != '\0') return NULL;
+
+    return option;
+}
+
+static int clib__opt_store(const ClibOption* option, Cstr value, void* out){
+    char* field = (char*) out + option->offset;
+    char* end = NULL;
+
+    switch(option->type){
+    case CLIB_OPT_FLAG:
+        *(int*) field = 1;
+        return 0;
+    case CLIB_OPT_STRING:
+        *(Cstr*) field = value ? value : "";
+        return 0;
+    default:
+        break;
+    }
+
+    // An omitted optional argument leaves numbers untouched
+    if(value == NULL) return 0;
+
+    errno = 0;
+    switch(option->type){
+    case CLIB_OPT_INT: {
+        long number = strtol(value, &end, 0);
+        if(number < INT32_MIN || number > INT32_MAX) errno = ERANGE;
+        *(int*) field = (int) number;
+        break;
+    }
+    case CLIB_OPT_LONG:
+        *(long*) field = strtol(value, &end, 0);
+        break;
+    case CLIB_OPT_DOUBLE:
+        *(double*) field = strtod(value, &end);
+        break;
+    default:
+        assert(0 && "unreachable");
+    }
+
+    if(errno != 0 || end == value || *end != '\0'){
+        if(option->full) ERRO("Invalid value for --%s: %s", option->full, value);
+        else ERRO("Invalid value for -%c: %s", option->abr, value);
+        return -1;
+    }
+    return 0;
+}
+
+// Parses argv into `out` without allocating. Positional arguments are moved
+// to argv[1..] in their original order and the new argc is returned, or -1
+// on error.
+CLIBAPI int clib_opt_parse(const ClibOptParser* parser, int argc, char** argv, void* out){
+    int positional = 1;
+    int i = 1;
+
+    for(; i < argc; ++i){
+        char* arg = argv[i];
+
+        if(arg[0] != '-' || arg[1] == '\0'){
+            argv[positional++] = arg;
+            continue;
+        }
+
+        if(arg[1] == '-'){
+            if(arg[2] == '\0') {
+                i++;
+                break;
+            }
+
+            Cstr name = arg + 2;
+            Cstr value = strchr(name, '=');
+            size_t length = value ? (size_t) (value - name) : strlen(name);
+            if(value) value++;
+
+            const ClibOption* option = clib_opt_find_long(parser, name, length);
+            if(option == NULL){
+                ERRO("Unknown option: --%.*s", (int) length, name);
+                return -1;
+            }
+
+            if(option->argument_required == no_argument && value){
+                ERRO("Option --%s takes no argument", option->full);
+                return -1;
+            }
+            if(option->argument_required == required_argument && value == NULL){
+                if(i + 1 >= argc){
+                    ERRO("Option --%s requires an argument", option->full);
+                    return -1;
+                }
+                value = argv[++i];
+            }
+
+            if(clib__opt_store(option, value, out) != 0) return -1;
+            continue;
+        }
+
+        // One or more bundled short options
+        for(char* c = arg + 1; *c; ++c){
+            uint8_t index = parser->shorts[(unsigned char) *c];
+            if(index == 0){
+                ERRO("Unknown option: -%c", *c);
+                return -1;
+            }
+
+            const ClibOption* option = &parser->options[index - 1];
+            if(option->argument_required == no_argument){
+                if(clib__opt_store(option, NULL, out) != 0) return -1;
+                continue;
+            }
+
+            Cstr value = c[1] ? c + 1 : NULL;
+            if(value == NULL && option->argument_required == required_argument){
+                if(i + 1 >= argc){
+                    ERRO("Option -%c requires an argument", option->abr);
+                    return -1;
+                }
+                value = argv[++i];
+            }
+
+            if(clib__opt_store(option, value, out) != 0) return -1;
+            break;
+        }
+    }
+
+    for(; i < argc; ++i){
+        argv[positional++] = argv[i];
+    }
+
+    return positional;
+}
+
+CLIBAPI void clib_opt_help(const ClibOption* options, size_t count, Cstr usage, Cstr footer){
+    CliArg args[CLIB_OPT_MAX];
+    CliArg* pointers[CLIB_OPT_MAX];
+
+    if(count > CLIB_OPT_MAX) count = CLIB_OPT_MAX;
+    for(size_t i = 0; i < count; ++i){
+        args[i] = (CliArg) {
+            .help = (char*) options[i].help,
+            .full = (char*) options[i].full,
+            .abr = options[i].abr,
+            .argument_required = options[i].argument_required,
+        };
+        pointers[i] = &args[i];
+    }
+
+    clib_cli_help((CliArguments) { .args = pointers, .count = count, .capacity = count }, usage, footer);
+}
+
+CLIBAPI void clib_command_help(const ClibCommand** path, size_t depth){
+    const ClibCommand* command = path[depth - 1];
+
+    char usage[256];
+    size_t length = 0;
+    for(size_t i = 0; i < depth && length < sizeof(usage); ++i){
+        length += snprintf(usage + length, sizeof(usage) - length, "%s%s", i ? " " : "", path[i]->name);
+    }
+    if(length < sizeof(usage)){
+        snprintf(usage + length, sizeof(usage) - length, "%s%s",
+            command->child_count ? " <command>" : "", command->option_count ? " [options]" : "");
+    }
+
+    if(command->help) printf("%s\n\n", command->help);
+    if(command->option_count) clib_opt_help(command->options, command->option_count, usage, NULL);
+    else printf("Usage: %s\n\n", usage);
+
+    if(command->child_count == 0) return;
+
+    size_t width = 0;
+    for(size_t i = 0; i < command->child_count; ++i){
+        size_t name_length = strlen(command->children[i].name);
+        if(name_length > width) width = name_length;
+    }
+
+    printf("Commands:\n");
+    for(size_t i = 0; i < command->child_count; ++i){
+        printf("  %-*s    %s\n", (int) width, command->children[i].name,
+            command->children[i].help ? command->children[i].help : "");
+    }
+    printf("\n");
+}
+
+static int clib__command_wants_help(const ClibCommand* command, int argc, char** argv){
+    for(size_t i = 0; i < command->option_count; ++i){
+        if(command->options[i].abr == 'h') return false;
+        if(command->options[i].full && strcmp(command->options[i].full, "help") == 0) return false;
+    }
+
+    for(int i = 1; i < argc; ++i){
+        if(strcmp(argv[i], "--") == 0) break;
+        if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) return true;
+    }
+    return false;
+}
+
+// Walks the leading command names of argv down the tree, then parses the
+// remaining arguments with the options of the command that was reached and
+// runs its handler. Returns what the handler returns, 1 on usage errors.
+CLIBAPI int clib_command_dispatch(const ClibCommand* root, int argc, char** argv, void* ctx){
+    const ClibCommand* path[CLIB_COMMAND_MAX_DEPTH] = { root };
+    size_t depth = 1;
+    int i = 1;
+
+    while(i < argc && argv[i][0] != '-' && path[depth - 1]->child_count && depth < CLIB_COMMAND_MAX_DEPTH){
+        const ClibCommand* command = path[depth - 1];
+        const ClibCommand* next = NULL;
+
+        for(size_t c = 0; c < command->child_count; ++c){
+            if(strcmp(command->children[c].name, argv[i]) == 0){
+                next = &command->children[c];
+                break;
+            }
+        }
+
+        if(next == NULL){
+            if(command->handler) break; // a positional argument of this command
+
+            ERRO("Unknown command: %s", argv[i]);
+            clib_command_help(path, depth);
+            return 1;
+        }
+
+        path[depth++] = next;
+        i++;
+    }
+
+    const ClibCommand* command = path[depth - 1];
+    argc -= i - 1;
+    argv += i - 1;
+
+    if(clib__command_wants_help(command, argc, argv)){
+        clib_command_help(path, depth);
+        return 0;
+    }
+
+    if(command->handler == NULL){
+        clib_command_help(path, depth);
+        return 1;
+    }
+
+    ClibOptParser parser;
+    if(clib_opt_parser_init(&parser, command->options, command->option_count) != 0) return 1;
+
+    argc = clib_opt_parse(&parser, argc, argv, command->values);
+    if(argc < 0){
+        clib_command_help(path, depth);
+        return 1;
+    }
+
+    return command->handler(argc, argv, command->values, ctx);
+}
+
+typedef size_t (*ClibLogPrefixWriter)(char* buffer, Cstr file, int line);
+
+static ClibLogPrefixWriter clib__log_writers[4];
+static size_t clib__log_writer_count = 0;
+
+// The formatted date is cached per thread and only the microseconds
+// are rewritten while the second stays the same
+typedef struct {
+    time_t second;
+    size_t length;
+    char text[32];
+} ClibLogTimeCache;
+
+static CLIB_THREAD_LOCAL ClibLogTimeCache clib__log_time_cache = { .second = -1 };
+
+static size_t clib__log_write_timestamp(char* buffer, Cstr file, int line){
+    (void) file;
+    (void) line;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    ClibLogTimeCache* cache = &clib__log_time_cache;
+    if(UNLIKELY(cache->second != now.tv_sec)){
+        struct tm tm;
+        localtime_r(&now.tv_sec, &tm);
+        cache->length = strftime(cache->text, sizeof(cache->text), "%Y-%m-%d %H:%M:%S.", &tm);
+        cache->second = now.tv_sec;
+    }
+
+    memcpy(buffer, cache->text, cache->length);
+    size_t length = cache->length;
+    length += clib_u64toa_width(buffer + length, now.tv_nsec / 1000, 6);
+    buffer[length++] = ' ';
+    return length;
+}
+
+static size_t clib__log_write_monotonic(char* buffer, Cstr file, int line){
+    (void) file;
+    (void) line;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    size_t length = 0;
+    buffer[length++] = '[';
+    length += clib_u64toa_width(buffer + length, now.tv_sec, 1);
+    buffer[length++] = '.';
+    length += clib_u64toa_width(buffer + length, now.tv_nsec / 1000, 6);
+    buffer[length++] = ']';
+    buffer[length++] = ' ';
+    return length;
+}
+
+static CLIB_THREAD_LOCAL char clib__log_tid_text[24];
+static CLIB_THREAD_LOCAL size_t clib__log_tid_length = 0;
+
+static size_t clib__log_write_tid(char* buffer, Cstr file, int line){
+    (void) file;
+    (void) line;
+    if(UNLIKELY(clib__log_tid_length == 0)){
+        size_t length = 0;
+        clib__log_tid_text[length++] = '(';
+        length += clib_u64toa_width(clib__log_tid_text + length, clib_thread_id(), 1);
+        clib__log_tid_text[length++] = ')';
+        clib__log_tid_text[length++] = ' ';
+        clib__log_tid_length = length;
+    }
+
+    memcpy(buffer, clib__log_tid_text, clib__log_tid_length);
+    return clib__log_tid_length;
+}
+
+static size_t clib__log_write_location(char* buffer, Cstr file, int line){
+    if(file == NULL) return 0;
+
+    // Leave room for the other prefixes and the line number
+    size_t file_length = strlen(file);
+    if(file_length > CLIB_LOG_PREFIX_MAX - 128) {
+        file += file_length - (CLIB_LOG_PREFIX_MAX - 128);
+        file_length = CLIB_LOG_PREFIX_MAX - 128;
+    }
+
+    memcpy(buffer, file, file_length);
+    size_t length = file_length;
+    buffer[length++] = ':';
+    length += clib_u64toa_width(buffer + length, (uint64_t) line, 1);
+    buffer[length++] = ':';
+    buffer[length++] = ' ';
+    return length;
+}
+
+CLIBAPI void clib_log_init(int prefix_flags){
+    clib__log_writer_count = 0;
+
+    if(prefix_flags & CLIB_LOG_TIMESTAMP)
+        clib__log_writers[clib__log_writer_count++] = clib__log_write_timestamp;
+    if(prefix_flags & CLIB_LOG_MONOTONIC)
+        clib__log_writers[clib__log_writer_count++] = clib__log_write_monotonic;
+    if(prefix_flags & CLIB_LOG_TID)
+        clib__log_writers[clib__log_writer_count++] = clib__log_write_tid;
+    if(prefix_flags & CLIB_LOG_LOCATION)
+        clib__log_writers[clib__log_writer_count++] = clib__log_write_location;
+}
+
+CLIBAPI void clib_log_prefix(FILE* stream, Cstr file, int line){
+    if(LIKELY(clib__log_writer_count == 0)) return;
+
+    char buffer[CLIB_LOG_PREFIX_MAX];
+    size_t length = clib__log_writers[0](buffer, file, line);
+    for(size_t i = 1; i < clib__log_writer_count; ++i){
+        length += clib__log_writers[i](buffer + length, file, line);
+    }
+    fwrite(buffer, 1, length, stream);
+}
+
+static void clib__log_va(Cstr file, int line, int log_level, char* format, va_list args){
+    CLIB_PROFILE_FUNCTION();
+    CLIB_METRIC_ADD(CLIB_METRIC_LOG_LINES, 1);
+    clib_log_prefix(stderr, file, line);
+
     switch(log_level){
     case CLIB_INFO:
         fprintf(stderr, "[INFO] ");
@@ -592,30 +2458,299 @@ CLIBAPI void clib_log(int log_level, char* format, ...){
         assert(0 && "unreachable");
     }
 
-    va_list args;
-    va_start(args, format);
     vfprintf(stderr, format, args);
-    va_end(args);
     fprintf(stderr, "\n");
 
     if(log_level == CLIB_PANIC) exit(1);
 }
 
+CLIBAPI void clib_log(int log_level, char* format, ...){
+    va_list args;
+    va_start(args, format);
+    clib__log_va(NULL, 0, log_level, format, args);
+    va_end(args);
+}
+
+CLIBAPI void clib_log_at(Cstr file, int line, int log_level, char* format, ...){
+    va_list args;
+    va_start(args, format);
+    clib__log_va(file, line, log_level, format, args);
+    va_end(args);
+}
+
+CLIBAPI int64_t clib_log_now_us(){
+    struct timespec now;
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+    return (int64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+CLIBAPI void clib_log_site_suppress(ClibLogSite* site){
+    CLIB_METRIC_ADD(CLIB_METRIC_LOG_DROPPED, 1);
+    // Not a fetch_add: losing a few counts under contention is cheaper than a locked increment
+    uint64_t suppressed = atomic_load_explicit(&site->suppressed, memory_order_relaxed);
+    atomic_store_explicit(&site->suppressed, suppressed + 1, memory_order_relaxed);
+
+    // The first line held back since the last report starts the summary timer
+    if(suppressed == 0){
+        atomic_store_explicit(&site->summary_us, clib_log_now_us() + CLIB_LOG_SUMMARY_MS * 1000, memory_order_relaxed);
+    }
+}
+
+CLIBAPI uint64_t clib_log_site_take_suppressed(ClibLogSite* site){
+    if(atomic_load_explicit(&site->suppressed, memory_order_relaxed) == 0) return 0;
+    return atomic_exchange_explicit(&site->suppressed, 0, memory_order_relaxed);
+}
+
+// Whether the suppressed lines should be reported now. Only one caller gets
+// true for each report. The clock is read at 1, 2, 4 ... 64 suppressed
+// lines and every 64 after, so most suppressed calls do not read it.
+CLIBAPI int clib_log_site_summary_due(ClibLogSite* site){
+    uint64_t suppressed = atomic_load_explicit(&site->suppressed, memory_order_relaxed);
+    uint64_t mask = suppressed < 64 ? suppressed - 1 : 63;
+    if(suppressed == 0 || (suppressed & mask) != 0) return false;
+
+    int64_t due = atomic_load_explicit(&site->summary_us, memory_order_relaxed);
+    if(clib_log_now_us() < due) return false;
+    return atomic_compare_exchange_strong_explicit(&site->summary_us, &due, INT64_MAX,
+        memory_order_relaxed, memory_order_relaxed);
+}
+
+CLIBAPI int clib_log_site_every_us(ClibLogSite* site, int64_t interval_us){
+    int64_t now = clib_log_now_us();
+    int64_t next = atomic_load_explicit(&site->next_us, memory_order_relaxed);
+
+    if(LIKELY(now < next) ||
+        !atomic_compare_exchange_strong_explicit(&site->next_us, &next, now + interval_us,
+            memory_order_relaxed, memory_order_relaxed)) {
+        clib_log_site_suppress(site);
+        return false;
+    }
+    return true;
+}
+
+// GCRA form of the token bucket: next_us is the theoretical arrival time of
+// the next line and a line passes while it is at most `burst` intervals ahead
+CLIBAPI int clib_log_site_rate(ClibLogSite* site, double per_second, int64_t burst){
+    if(per_second <= 0) return false;
+
+    int64_t interval = (int64_t) (1000000.0 / per_second);
+    int64_t tolerance = interval * (burst > 1 ? burst - 1 : 0);
+    int64_t now = clib_log_now_us();
+    int64_t tat = atomic_load_explicit(&site->next_us, memory_order_relaxed);
+
+    for(;;){
+        if(now < tat - tolerance) {
+            clib_log_site_suppress(site);
+            return false;
+        }
+
+        int64_t next = (tat > now ? tat : now) + interval;
+        if(atomic_compare_exchange_weak_explicit(&site->next_us, &tat, next,
+            memory_order_relaxed, memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
 #ifdef CLIB_MENUS
+// The key of every byte read on its own
+#define CLIB__KEY_BYTE(n) \
+    (n) == 9 ? CLIB_KEY_TAB : \
+    (n) == 10 || (n) == 13 ? CLIB_KEY_ENTER : \
+    (n) == 8 || (n) == 127 ? CLIB_KEY_BACKSPACE : \
+    (n) == 27 ? CLIB_KEY_ESC : \
+    (n) == 0 ? (CLIB_KEY_MOD_CTRL | ' ') : \
+    (n) < 27 ? (CLIB_KEY_MOD_CTRL | ('a' + (n) - 1)) : \
+    (n) < 32 ? CLIB_KEY_UNKNOWN : (n),
+
+static const int16_t clib__key_bytes[256] = { CLIB__BYTE_VALUES(CLIB__KEY_BYTE) };
+
 #ifndef _WIN32
-    int _getch() {
-        struct termios oldt, newt;
-        int ch;
-        tcgetattr(STDIN_FILENO, &oldt);
-        newt = oldt;
-        newt.c_lflag &= ~(ICANON | ECHO);
-        tcsetattr(STDIN_FILENO, TCSANOW, &newt);
-        ch = getchar();
-        tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-        return ch;
+// Keys of "\e[<params><final>" and "\e O<final>" by their final byte,
+// and of "\e[<n>~" by n. Zero is an unknown sequence.
+static const int16_t clib__key_finals[128] = {
+    ['A'] = CLIB_KEY_ARROW_UP,
+    ['B'] = CLIB_KEY_ARROW_DOWN,
+    ['C'] = CLIB_KEY_ARROW_RIGHT,
+    ['D'] = CLIB_KEY_ARROW_LEFT,
+    ['H'] = CLIB_KEY_HOME,
+    ['F'] = CLIB_KEY_END,
+    ['P'] = CLIB_KEY_F1,
+    ['Q'] = CLIB_KEY_F2,
+    ['R'] = CLIB_KEY_F3,
+    ['S'] = CLIB_KEY_F4,
+    ['Z'] = CLIB_KEY_MOD_SHIFT | CLIB_KEY_TAB,
+};
+
+static const int16_t clib__key_tildes[32] = {
+    [1] = CLIB_KEY_HOME,
+    [2] = CLIB_KEY_INSERT,
+    [3] = CLIB_KEY_DELETE,
+    [4] = CLIB_KEY_END,
+    [5] = CLIB_KEY_PAGE_UP,
+    [6] = CLIB_KEY_PAGE_DOWN,
+    [7] = CLIB_KEY_HOME,
+    [8] = CLIB_KEY_END,
+    [11] = CLIB_KEY_F1,
+    [12] = CLIB_KEY_F2,
+    [13] = CLIB_KEY_F3,
+    [14] = CLIB_KEY_F4,
+    [15] = CLIB_KEY_F5,
+    [17] = CLIB_KEY_F6,
+    [18] = CLIB_KEY_F7,
+    [19] = CLIB_KEY_F8,
+    [20] = CLIB_KEY_F9,
+    [21] = CLIB_KEY_F10,
+    [23] = CLIB_KEY_F11,
+    [24] = CLIB_KEY_F12,
+};
+
+CLIBAPI void clib_input_begin(ClibInput* input, int fd, int bracketed_paste){
+    if(input->active) return;
+
+    input->fd = fd;
+    input->pasting = false;
+    if(input->escape_timeout_ms <= 0) input->escape_timeout_ms = CLIB_INPUT_ESCAPE_TIMEOUT_MS;
+
+    input->is_tty = tcgetattr(fd, &input->saved) == 0;
+    if(input->is_tty){
+        struct termios raw = input->saved;
+        raw.c_lflag &= ~(ICANON | ECHO);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &raw);
+    }
+
+    input->bracketed_paste = bracketed_paste && input->is_tty;
+    if(input->bracketed_paste) CLIB_TERM_LITERAL("\e[?2004h");
+
+    input->active = true;
+}
+
+CLIBAPI void clib_input_end(ClibInput* input){
+    if(!input->active) return;
+
+    if(input->bracketed_paste) CLIB_TERM_LITERAL("\e[?2004l");
+    if(input->is_tty) tcsetattr(input->fd, TCSANOW, &input->saved);
+
+    input->active = false;
+}
+
+// Reads whatever is available, waiting up to timeout_ms (-1 for ever).
+// Returns false when nothing arrived.
+static int clib__input_fill(ClibInput* input, int timeout_ms){
+    if(input->start > 0){
+        memmove(input->buffer, input->buffer + input->start, input->length);
+        input->start = 0;
+    }
+    if(input->length == CLIB_INPUT_BUFFER) return false;
+
+    struct pollfd pfd = { .fd = input->fd, .events = POLLIN };
+    int ready;
+    do {
+        ready = poll(&pfd, 1, timeout_ms);
+    } while(ready < 0 && errno == EINTR);
+    if(ready <= 0) return false;
+
+    ssize_t bytes;
+    do {
+        bytes = read(input->fd, input->buffer + input->length, CLIB_INPUT_BUFFER - input->length);
+    } while(bytes < 0 && errno == EINTR);
+    if(bytes <= 0) return false;
+
+    input->length += bytes;
+    return true;
+}
+
+// Decodes the key at the start of s. Returns the bytes it takes,
+// or 0 when the escape sequence has not fully arrived.
+static size_t clib__input_decode(const unsigned char* s, size_t length, int* key){
+    if(s[0] != '\e'){
+        *key = clib__key_bytes[s[0]];
+        return 1;
+    }
+    if(length < 2) return 0;
+
+    // ESC before any other key is that key with Alt
+    if(s[1] != '[' && s[1] != 'O'){
+        int base = clib__key_bytes[s[1]];
+        *key = base < 0 ? CLIB_KEY_UNKNOWN : base | CLIB_KEY_MOD_ALT;
+        return 2;
     }
+
+    int params[2] = {0};
+    int count = 0;
+    size_t i = 2;
+    for(; i < length && s[i] >= 0x20 && s[i] <= 0x3f; ++i){
+        if(s[i] == ';') count++;
+        else if(s[i] >= '0' && s[i] <= '9' && count < 2 && params[count] < 10000) params[count] = params[count] * 10 + (s[i] - '0');
+    }
+    if(i == length) return 0;
+
+    int final = s[i];
+    int base = 0;
+    if(final == '~'){
+        if(params[0] < 32) base = clib__key_tildes[params[0]];
+        else if(params[0] == 200) base = CLIB_KEY_PASTE_BEGIN;
+        else if(params[0] == 201) base = CLIB_KEY_PASTE_END;
+    }
+    else if(final < 128) {
+        base = clib__key_finals[final];
+    }
+
+    // The second parameter is 1 plus the modifier bits
+    int mods = params[1] > 1 ? params[1] - 1 : 0;
+    *key = base == 0 ? CLIB_KEY_UNKNOWN : base |
+        (mods & 1 ? CLIB_KEY_MOD_SHIFT : 0) |
+        (mods & 2 ? CLIB_KEY_MOD_ALT : 0) |
+        (mods & 4 ? CLIB_KEY_MOD_CTRL : 0);
+    return i + 1;
+}
+
+// Returns the next key, or CLIB_KEY_NONE when none arrives within
+// timeout_ms (-1 waits for ever) or the input has ended
+CLIBAPI int clib_input_read(ClibInput* input, int timeout_ms){
+    while(true){
+        if(input->length > 0){
+            int key;
+            size_t used = clib__input_decode(input->buffer + input->start, input->length, &key);
+
+            // The rest of the sequence did not follow: it was a lone ESC
+            if(used == 0 && !clib__input_fill(input, input->escape_timeout_ms)){
+                key = CLIB_KEY_ESC;
+                used = 1;
+            }
+
+            if(used > 0){
+                input->start += used;
+                input->length -= used;
+                if(key == CLIB_KEY_PASTE_BEGIN) input->pasting = true;
+                if(key == CLIB_KEY_PASTE_END) input->pasting = false;
+                return key;
+            }
+            continue;
+        }
+
+        if(!clib__input_fill(input, timeout_ms)) return CLIB_KEY_NONE;
+    }
+}
+
+// The session behind clib_getch and the input buffering functions
+static ClibInput clib__input = {0};
 #endif
 
+static int clib__input_pasting(){
+    #ifdef _WIN32
+        return false;
+    #else
+        return clib__input.pasting;
+    #endif
+}
+
 CLIBAPI void clib_enable_input_buffering(){
     #ifdef _WIN32
         // Enable console input buffering
@@ -628,11 +2763,7 @@ CLIBAPI void clib_enable_input_buffering(){
 
         SetConsoleMode(hConsoleInput, consoleMode);
     #else
-        struct termios term;
-        tcgetattr(STDIN_FILENO, &term);
-        term.c_lflag |= (ICANON | ECHO);
-        tcsetattr(STDIN_FILENO, TCSANOW, &term);
-
+        clib_input_end(&clib__input);
     #endif
     SHOW_CURSOR();
 }
@@ -645,19 +2776,14 @@ CLIBAPI void clib_disable_input_buffering(){
         GetConsoleMode(hInput, &mode);
         SetConsoleMode(hInput, mode & ~ENABLE_ECHO_INPUT & ~ENABLE_LINE_INPUT);
     #else
-        struct termios term;
-        tcgetattr(STDIN_FILENO, &term);
-        term.c_lflag &= ~(ICANON | ECHO);
-        tcsetattr(STDIN_FILENO, TCSANOW, &term);
-
+        clib_input_begin(&clib__input, STDIN_FILENO, true);
     #endif
     HIDE_CURSOR();
 }
 
 CLIBAPI int clib_getch() {
-    int ch;
     #ifdef _WIN32
-        ch = _getch();
+        int ch = _getch();
         if (ch == 0 || ch == 224) {
             // Handle extended keys (arrows, function keys)
             ch = _getch();
@@ -666,117 +2792,482 @@ CLIBAPI int clib_getch() {
                 case 80: return CLIB_KEY_ARROW_DOWN;
                 case 75: return CLIB_KEY_ARROW_LEFT;
                 case 77: return CLIB_KEY_ARROW_RIGHT;
+                case 71: return CLIB_KEY_HOME;
+                case 79: return CLIB_KEY_END;
+                case 73: return CLIB_KEY_PAGE_UP;
+                case 81: return CLIB_KEY_PAGE_DOWN;
+                case 82: return CLIB_KEY_INSERT;
+                case 83: return CLIB_KEY_DELETE;
                 default: return CLIB_KEY_UNKNOWN;
             }
         }
+        return ch >= 0 && ch < 256 ? clib__key_bytes[ch] : CLIB_KEY_UNKNOWN;
     #else
-        ch = _getch();
-        if (ch == 27) {
-            if (getchar() == '[') {
-                switch (getchar()) {
-                    case 'A': return CLIB_KEY_ARROW_UP;
-                    case 'B': return CLIB_KEY_ARROW_DOWN;
-                    case 'C': return CLIB_KEY_ARROW_RIGHT;
-                    case 'D': return CLIB_KEY_ARROW_LEFT;
-                    default: return CLIB_KEY_UNKNOWN;
-                }
-            }
-            return CLIB_KEY_ESC;
-        }
+        // Outside a session, raw mode only lasts for this key
+        int transient = !clib__input.active;
+        if(transient) clib_input_begin(&clib__input, STDIN_FILENO, false);
+        int key = clib_input_read(&clib__input, -1);
+        if(transient) clib_input_end(&clib__input);
+        return key;
     #endif
-
-    switch (ch) {
-        case 10: return CLIB_KEY_ENTER;
-        case 127: return CLIB_KEY_BACKSPACE;
-        case 9: return CLIB_KEY_TAB;
-        case 27: return CLIB_KEY_ESC;
-        case 32: return CLIB_KEY_SPACE;
-        case '0': return CLIB_KEY_0;
-        case '1': return CLIB_KEY_1;
-        case '2': return CLIB_KEY_2;
-        case '3': return CLIB_KEY_3;
-        case '4': return CLIB_KEY_4;
-        case '5': return CLIB_KEY_5;
-        case '6': return CLIB_KEY_6;
-        case '7': return CLIB_KEY_7;
-        case '8': return CLIB_KEY_8;
-        case '9': return CLIB_KEY_9;
-        case 'A': return CLIB_KEY_A;
-        case 'B': return CLIB_KEY_B;
-        case 'C': return CLIB_KEY_C;
-        case 'D': return CLIB_KEY_D;
-        case 'E': return CLIB_KEY_E;
-        case 'F': return CLIB_KEY_F;
-        case 'G': return CLIB_KEY_G;
-        case 'H': return CLIB_KEY_H;
-        case 'I': return CLIB_KEY_I;
-        case 'J': return CLIB_KEY_J;
-        case 'K': return CLIB_KEY_K;
-        case 'L': return CLIB_KEY_L;
-        case 'M': return CLIB_KEY_M;
-        case 'N': return CLIB_KEY_N;
-        case 'O': return CLIB_KEY_O;
-        case 'P': return CLIB_KEY_P;
-        case 'Q': return CLIB_KEY_Q;
-        case 'R': return CLIB_KEY_R;
-        case 'S': return CLIB_KEY_S;
-        case 'T': return CLIB_KEY_T;
-        case 'U': return CLIB_KEY_U;
-        case 'V': return CLIB_KEY_V;
-        case 'W': return CLIB_KEY_W;
-        case 'X': return CLIB_KEY_X;
-        case 'Y': return CLIB_KEY_Y;
-        case 'Z': return CLIB_KEY_Z;
-        case 'a': return CLIB_KEY_a;
-        case 'b': return CLIB_KEY_b;
-        case 'c': return CLIB_KEY_c;
-        case 'd': return CLIB_KEY_d;
-        case 'e': return CLIB_KEY_e;
-        case 'f': return CLIB_KEY_f;
-        case 'g': return CLIB_KEY_g;
-        case 'h': return CLIB_KEY_h;
-        case 'i': return CLIB_KEY_i;
-        case 'j': return CLIB_KEY_j;
-        case 'k': return CLIB_KEY_k;
-        case 'l': return CLIB_KEY_l;
-        case 'm': return CLIB_KEY_m;
-        case 'n': return CLIB_KEY_n;
-        case 'o': return CLIB_KEY_o;
-        case 'p': return CLIB_KEY_p;
-        case 'q': return CLIB_KEY_q;
-        case 'r': return CLIB_KEY_r;
-        case 's': return CLIB_KEY_s;
-        case 't': return CLIB_KEY_t;
-        case 'u': return CLIB_KEY_u;
-        case 'v': return CLIB_KEY_v;
-        case 'w': return CLIB_KEY_w;
-        case 'x': return CLIB_KEY_x;
-        case 'y': return CLIB_KEY_y;
-        case 'z': return CLIB_KEY_z;
-        // Add other mappings as needed
-        default: return CLIB_KEY_UNKNOWN;
-    }
 }
 
 
 CLIBAPI void clib_default_print_option(Cstr option, int is_selected, int color){
-    is_selected ? printf("%s%s%s", COLOR_BG(color), option, RESET) : printf("%s", option);
+    is_selected ? clib_term_printf("%s%s%s", COLOR_BG(color), option, RESET) : clib_term_printf("%s", option);
 }
 
 CLIBAPI void clib_arrow_print_option(Cstr option, int is_selected, int color){
-    is_selected ? printf("%s>%s %s", COLOR_FG(color), RESET, option) : printf("  %s", option);
+    is_selected ? clib_term_printf("%s>%s %s", COLOR_FG(color), RESET, option) : clib_term_printf("  %s", option);
 }
 
 CLIBAPI void clib_brackets_print_option(Cstr option, int is_selected, int color){
-    is_selected ? printf("%s[%s%s%s]%s", COLOR_FG(color), RESET, option, COLOR_FG(color), RESET) : printf(" %s ", option);
+    is_selected ? clib_term_printf("%s[%s%s%s]%s", COLOR_FG(color), RESET, option, COLOR_FG(color), RESET) : clib_term_printf(" %s ", option);
 }
 
-CLIBAPI int clib_menu(Cstr title, int color, ClibPrintOptionFunc print_option, Cstr first_option, ...){
-    clib_disable_input_buffering();
+static const ClibCell clib__blank_cell = { .glyph = " ", .fg = CLIB_COLOR_DEFAULT, .bg = CLIB_COLOR_DEFAULT };
 
-    int selected = 0;
-    size_t size = 0;
-    CstrArray options = {0};
+CLIBAPI void clib_screen_init(ClibScreen* screen, int width, int height){
+    *screen = (ClibScreen) { .width = width, .height = height };
+    screen->front = (ClibCell*) clib_safe_malloc(sizeof(ClibCell) * width * height);
+    screen->back = (ClibCell*) clib_safe_malloc(sizeof(ClibCell) * width * height);
+    clib_termbuf_init(&screen->out, STDOUT_FILENO);
+    clib_screen_clear(screen);
+}
+
+CLIBAPI void clib_screen_free(ClibScreen* screen){
+    free(screen->front);
+    free(screen->back);
+    clib_termbuf_free(&screen->out);
+}
+
+CLIBAPI void clib_screen_clear(ClibScreen* screen){
+    for(int i = 0; i < screen->width * screen->height; ++i){
+        screen->back[i] = clib__blank_cell;
+    }
+}
+
+static int clib__sgr_color(const int* params, int count, int* i){
+    if(*i + 2 < count && params[*i + 1] == 5){
+        *i += 2;
+        return params[*i] & 0xff;
+    }
+    if(*i + 4 < count && params[*i + 1] == 2){
+        *i += 4;
+        return CLIB_COLOR_RGB(params[*i - 2] & 0xff, params[*i - 1] & 0xff, params[*i] & 0xff);
+    }
+    return CLIB_COLOR_DEFAULT;
+}
+
+static void clib__sgr_apply(ClibCell* style, const int* params, int count){
+    if(count == 0) {
+        *style = clib__blank_cell;
+        return;
+    }
+
+    for(int i = 0; i < count; ++i){
+        int p = params[i];
+        if(p == 0) {
+            style->fg = style->bg = CLIB_COLOR_DEFAULT;
+            style->attrs = 0;
+        }
+        else if(p == 1) style->attrs |= CLIB_ATTR_BOLD;
+        else if(p == 3) style->attrs |= CLIB_ATTR_ITALIC;
+        else if(p == 4) style->attrs |= CLIB_ATTR_UNDERLINE;
+        else if(p == 22) style->attrs &= ~CLIB_ATTR_BOLD;
+        else if(p == 23) style->attrs &= ~CLIB_ATTR_ITALIC;
+        else if(p == 24) style->attrs &= ~CLIB_ATTR_UNDERLINE;
+        else if(p >= 30 && p <= 37) style->fg = p - 30;
+        else if(p == 38) style->fg = clib__sgr_color(params, count, &i);
+        else if(p == 39) style->fg = CLIB_COLOR_DEFAULT;
+        else if(p >= 40 && p <= 47) style->bg = p - 40;
+        else if(p == 48) style->bg = clib__sgr_color(params, count, &i);
+        else if(p == 49) style->bg = CLIB_COLOR_DEFAULT;
+        else if(p >= 90 && p <= 97) style->fg = p - 90 + 8;
+        else if(p >= 100 && p <= 107) style->bg = p - 100 + 8;
+    }
+}
+
+// Draws one line of text into the back buffer, following its SGR sequences.
+// Every character takes one column. Returns the column after the text.
+CLIBAPI int clib_screen_put(ClibScreen* screen, int row, int col, Cstr text, size_t length){
+    if(row < 0 || row >= screen->height) return col;
+
+    ClibCell style = clib__blank_cell;
+    ClibCell* cells = screen->back + row * screen->width;
+
+    for(size_t i = 0; i < length && text[i] != '\n'; ){
+        unsigned char c = (unsigned char) text[i];
+
+        if(c == '\e'){
+            if(i + 1 < length && text[i + 1] == '['){
+                int params[16];
+                int count = 0, value = 0, has_value = false;
+                size_t j = i + 2;
+                for(; j < length && ((text[j] >= '0' && text[j] <= '9') || text[j] == ';'); ++j){
+                    if(text[j] == ';'){
+                        if(count < 16) params[count++] = value;
+                        value = 0;
+                        has_value = false;
+                    } else {
+                        value = value * 10 + (text[j] - '0');
+                        has_value = true;
+                    }
+                }
+                if(has_value && count < 16) params[count++] = value;
+                if(j < length && text[j] == 'm') clib__sgr_apply(&style, params, count);
+                i = j + 1;
+            } else {
+                i += 2;
+            }
+            continue;
+        }
+
+        size_t size = c < 0x80 ? 1 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+        if(c < 0x20 || i + size > length) {
+            i++;
+            continue;
+        }
+
+        if(col >= 0 && col < screen->width){
+            ClibCell* cell = &cells[col];
+            *cell = style;
+            memset(cell->glyph, 0, sizeof(cell->glyph));
+            memcpy(cell->glyph, text + i, size);
+        }
+        col++;
+        i += size;
+    }
+
+    return col;
+}
+
+static int clib__cell_equal(const ClibCell* a, const ClibCell* b){
+    return memcmp(a->glyph, b->glyph, sizeof(a->glyph)) == 0 &&
+        a->fg == b->fg && a->bg == b->bg && a->attrs == b->attrs;
+}
+
+static int clib__cell_same_style(const ClibCell* a, const ClibCell* b){
+    return a->fg == b->fg && a->bg == b->bg && a->attrs == b->attrs;
+}
+
+static void clib__screen_write_color(ClibTermBuf* out, int32_t color, int base){
+    char text[32];
+    size_t length = 0;
+    text[length++] = ';';
+
+    if(color == CLIB_COLOR_DEFAULT) {
+        length += clib_u64toa(text + length, base + 9);
+    }
+    else if(color & (1 << 24)) {
+        length += clib_u64toa(text + length, base + 8);
+        memcpy(text + length, ";2;", 3);
+        length += 3;
+        length += clib_u64toa(text + length, (color >> 16) & 0xff);
+        text[length++] = ';';
+        length += clib_u64toa(text + length, (color >> 8) & 0xff);
+        text[length++] = ';';
+        length += clib_u64toa(text + length, color & 0xff);
+    }
+    else {
+        length += clib_u64toa(text + length, base + 8);
+        memcpy(text + length, ";5;", 3);
+        length += 3;
+        length += clib_u64toa(text + length, color);
+    }
+
+    clib_termbuf_write(out, text, length);
+}
+
+static void clib__screen_write_style(ClibTermBuf* out, const ClibCell* cell){
+    if(clib__cell_same_style(cell, &clib__blank_cell)){
+        CLIB_TERMBUF_LITERAL(out, "\e[0m");
+        return;
+    }
+
+    CLIB_TERMBUF_LITERAL(out, "\e[0");
+    if(cell->attrs & CLIB_ATTR_BOLD) CLIB_TERMBUF_LITERAL(out, ";1");
+    if(cell->attrs & CLIB_ATTR_ITALIC) CLIB_TERMBUF_LITERAL(out, ";3");
+    if(cell->attrs & CLIB_ATTR_UNDERLINE) CLIB_TERMBUF_LITERAL(out, ";4");
+    clib__screen_write_color(out, cell->fg, 30);
+    clib__screen_write_color(out, cell->bg, 40);
+    CLIB_TERMBUF_LITERAL(out, "m");
+}
+
+static void clib__screen_move(ClibScreen* screen, int row, int col){
+    ClibTermBuf* out = &screen->out;
+
+    if(row < screen->cursor_row) clib_termbuf_printf(out, "\e[%dA", screen->cursor_row - row);
+    else if(row > screen->cursor_row) clib_termbuf_printf(out, "\e[%dB", row - screen->cursor_row);
+
+    if(col != screen->cursor_col || row != screen->cursor_row){
+        if(col == 0) CLIB_TERMBUF_LITERAL(out, "\r");
+        else clib_termbuf_printf(out, "\e[%dG", col + 1);
+    }
+
+    screen->cursor_row = row;
+    screen->cursor_col = col;
+}
+
+// Sends the cells of the back buffer that differ from the front buffer,
+// as runs with one cursor movement each, then swaps the buffers
+CLIBAPI void clib_screen_present(ClibScreen* screen){
+    ClibTermBuf* out = &screen->out;
+    if(out->sync) CLIB_TERMBUF_LITERAL(out, SYNC_UPDATE_BEGIN);
+
+    // The region is created on the first frame, by writing every row
+    if(!screen->presented){
+        out->styled = true;
+        for(int row = 1; row < screen->height; ++row) CLIB_TERMBUF_LITERAL(out, "\n");
+        if(screen->height > 1) clib_termbuf_printf(out, "\e[%dA", screen->height - 1);
+        CLIB_TERMBUF_LITERAL(out, "\r");
+        screen->cursor_row = screen->cursor_col = 0;
+
+        for(int i = 0; i < screen->width * screen->height; ++i){
+            screen->front[i] = clib__blank_cell;
+            screen->front[i].glyph[0] = '\0'; // differs from every cell
+        }
+        screen->presented = true;
+    }
+
+    ClibCell style = clib__blank_cell;
+    int style_known = false;
+
+    for(int row = 0; row < screen->height; ++row){
+        ClibCell* back = screen->back + row * screen->width;
+        ClibCell* front = screen->front + row * screen->width;
+
+        int last = screen->width - 1;
+        while(last >= 0 && clib__cell_equal(&back[last], &clib__blank_cell)) last--;
+
+        for(int col = 0; col < screen->width; ){
+            if(clib__cell_equal(&back[col], &front[col])) {
+                col++;
+                continue;
+            }
+
+            clib__screen_move(screen, row, col);
+
+            // Everything from here on is blank: erase the rest of the line
+            if(col > last){
+                if(!style_known || !clib__cell_same_style(&style, &clib__blank_cell)){
+                    CLIB_TERMBUF_LITERAL(out, "\e[0m");
+                    style = clib__blank_cell;
+                    style_known = true;
+                }
+                CLIB_TERMBUF_LITERAL(out, "\e[K");
+                break;
+            }
+
+            // A run ends after a few unchanged cells, where moving is cheaper than rewriting
+            int end = col, unchanged = 0;
+            while(end <= last && unchanged < 4){
+                unchanged = clib__cell_equal(&back[end], &front[end]) ? unchanged + 1 : 0;
+                end++;
+            }
+            end -= unchanged;
+
+            for(; col < end; ++col){
+                if(!style_known || !clib__cell_same_style(&style, &back[col])){
+                    clib__screen_write_style(out, &back[col]);
+                    style = back[col];
+                    style_known = true;
+                }
+                clib_termbuf_write(out, back[col].glyph, strnlen(back[col].glyph, sizeof(back[col].glyph)));
+            }
+            screen->cursor_col = col;
+
+            // The terminal holds the cursor on the last column instead of wrapping
+            if(col >= screen->width) screen->cursor_col = screen->width - 1;
+        }
+    }
+
+    if(style_known && !clib__cell_same_style(&style, &clib__blank_cell)) CLIB_TERMBUF_LITERAL(out, "\e[0m");
+    if(out->sync) CLIB_TERMBUF_LITERAL(out, SYNC_UPDATE_END);
+    clib_termbuf_flush(out);
+
+    ClibCell* swap = screen->front;
+    screen->front = screen->back;
+    screen->back = swap;
+    memcpy(screen->back, screen->front, sizeof(ClibCell) * screen->width * screen->height);
+}
+
+// Leaves the cursor on the line after the region
+CLIBAPI void clib_screen_release(ClibScreen* screen){
+    if(screen->presented){
+        clib__screen_move(screen, screen->height - 1, 0);
+        CLIB_TERMBUF_LITERAL(&screen->out, "\n");
+        clib_termbuf_flush(&screen->out);
+    }
+    screen->presented = false;
+}
+
+typedef struct {
+    size_t index;
+    size_t end; // just past the last character the query matched
+    size_t length; // of the option, measured once when the menu opens
+} ClibMenuMatch;
+
+static Cstr clib__menu_item(const ClibMenuConfig* config, size_t index){
+    return config->items != NULL ? config->items[index] : config->get_item(index, config->ctx);
+}
+
+static char clib__ascii_lower(char c){
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+static char clib__ascii_upper(char c){
+    return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
+
+// Narrows the matches of the previous query to those of the query plus c.
+// Each option continues from where the previous query stopped matching.
+static size_t clib__menu_refine(const ClibMenuConfig* config, const ClibMenuMatch* from, size_t count, char c, ClibMenuMatch* to){
+    // Either case of c, or just c when it is not a letter
+    char both[2] = { clib__ascii_lower(c), clib__ascii_upper(c) };
+    CstrView cases = { both, both[0] == both[1] ? 1 : 2 };
+
+    size_t kept = 0;
+    for(size_t i = 0; i < count; ++i){
+        Cstr item = clib__menu_item(config, from[i].index);
+        CstrView rest = { item + from[i].end, from[i].length - from[i].end };
+        size_t found = clib_str_find_any(rest, cases);
+        if(found != CLIB_STR_NPOS){
+            to[kept] = from[i];
+            to[kept].end += found + 1;
+            kept++;
+        }
+    }
+    return kept;
+}
+
+// Starts capturing the clib_term_* output of one row
+static void clib__menu_row_begin(ClibTermBuf* line){
+    line->length = 0;
+    line->styled = false;
+    line->last_sgr[0] = '\0';
+}
+
+CLIBAPI long clib_menu_select(const ClibMenuConfig* config){
+    if(config->count == 0) return -1;
+
+    int columns, rows;
+    clib_term_size(&columns, &rows);
+    int title_rows = config->title != NULL;
+    int prompt_rows = config->filter != 0;
+
+    int visible = config->visible_rows;
+    if(visible <= 0){
+        // Matches never outnumber the options, filtered or not
+        visible = rows - title_rows - prompt_rows - 1;
+        if(config->count < (size_t) visible) visible = config->count;
+        if(visible < 1) visible = 1;
+    }
+
+    // levels[i] holds the matches of the first i characters of the query
+    ClibMenuMatch* levels[CLIB_MENU_QUERY_MAX + 1] = {0};
+    size_t counts[CLIB_MENU_QUERY_MAX + 1] = {0};
+    char query[CLIB_MENU_QUERY_MAX + 1] = {0};
+    size_t depth = 0;
+
+    levels[0] = (ClibMenuMatch*) clib_safe_malloc(sizeof(ClibMenuMatch) * config->count);
+    for(size_t i = 0; i < config->count; ++i){
+        levels[0][i] = (ClibMenuMatch) { .index = i, .end = 0, .length = strlen(clib__menu_item(config, i)) };
+    }
+    counts[0] = config->count;
+
+    clib_disable_input_buffering();
+
+    ClibScreen screen;
+    clib_screen_init(&screen, columns, title_rows + prompt_rows + visible);
+
+    // print_option writes into `line`, which is then drawn into the screen
+    ClibTermBuf line;
+    clib_termbuf_init(&line, STDOUT_FILENO);
+
+    size_t selected = 0, top = 0;
+    long result = -1;
+
+    while(true){
+        size_t count = counts[depth];
+        if(selected < top) top = selected;
+        if(selected >= top + visible) top = selected - visible + 1;
+
+        clib_screen_clear(&screen);
+        ClibTermBuf* previous = clib_term_redirect(&line);
+        int row = 0;
+
+        if(config->title != NULL){
+            clib__menu_row_begin(&line);
+            clib_term_printf("%s%s%s", COLOR_FG(config->color), config->title, RESET);
+            clib_screen_put(&screen, row++, 0, line.data, line.length);
+        }
+
+        if(config->filter){
+            clib__menu_row_begin(&line);
+            clib_term_printf("%s>%s %s  %s%zu/%zu%s", COLOR_FG(config->color), RESET, query, COLOR_FG(8), count, config->count, RESET);
+            clib_screen_put(&screen, row++, 0, line.data, line.length);
+        }
+
+        for(size_t i = top; i < count && i < top + visible; ++i){
+            clib__menu_row_begin(&line);
+            config->print_option(clib__menu_item(config, levels[depth][i].index), i == selected, config->color);
+            clib_screen_put(&screen, row++, 0, line.data, line.length);
+        }
+
+        clib_term_redirect(previous);
+        clib_screen_present(&screen);
+
+        int pressed = clib_getch();
+        if(pressed == CLIB_KEY_NONE) {
+            break;
+        }
+        else if(pressed == CLIB_KEY_ARROW_UP) {
+            if(count > 0) selected = selected == 0 ? count - 1 : selected - 1;
+        }
+        else if(pressed == CLIB_KEY_ARROW_DOWN) {
+            if(count > 0) selected = selected + 1 == count ? 0 : selected + 1;
+        }
+        else if(pressed == CLIB_KEY_ENTER) {
+            if(count == 0 || clib__input_pasting()) continue;
+            result = levels[depth][selected].index;
+            break;
+        }
+        else if(!config->filter) {
+            continue;
+        }
+        else if(pressed == CLIB_KEY_ESC) {
+            // Clears the query, or cancels when it is already empty
+            if(depth == 0) break;
+            for(; depth > 0; --depth) free(levels[depth]);
+            query[0] = '\0';
+            selected = top = 0;
+        }
+        else if(pressed == CLIB_KEY_BACKSPACE) {
+            if(depth == 0) continue;
+            free(levels[depth]);
+            query[--depth] = '\0';
+            selected = top = 0;
+        }
+        else if(pressed >= ' ' && pressed < 127 && depth < CLIB_MENU_QUERY_MAX) {
+            levels[depth + 1] = (ClibMenuMatch*) clib_safe_malloc(sizeof(ClibMenuMatch) * (count > 0 ? count : 1));
+            counts[depth + 1] = clib__menu_refine(config, levels[depth], count, (char) pressed, levels[depth + 1]);
+            query[depth++] = (char) pressed;
+            selected = top = 0;
+        }
+    }
+
+    clib_screen_release(&screen);
+    clib_enable_input_buffering();
+    clib_screen_free(&screen);
+    clib_termbuf_free(&line);
+    for(size_t i = 0; i <= depth; ++i) free(levels[i]);
+
+    return result;
+}
+
+CLIBAPI int clib_menu(Cstr title, int color, ClibPrintOptionFunc print_option, Cstr first_option, ...){
+    CstrArray options = {0};
 
     if (first_option == NULL) {
         return -1;
@@ -784,12 +3275,9 @@ CLIBAPI int clib_menu(Cstr title, int color, ClibPrintOptionFunc print_option, C
 
     va_list args;
     va_start(args, first_option);
-    options.count++;
-    Cstr next = NULL;
-    for (next = va_arg(args, Cstr); next != NULL; ) {
-        next = va_arg(args, Cstr);
-        if(next)
-            options.count++;
+    options.count = 1;
+    while (va_arg(args, Cstr) != NULL) {
+        options.count++;
     }
     va_end(args);
 
@@ -797,49 +3285,215 @@ CLIBAPI int clib_menu(Cstr title, int color, ClibPrintOptionFunc print_option, C
     if (options.items == NULL) {
         PANIC("could not allocate memory: %s", strerror(errno));
     }
-    options.count = 0;
-
-    options.items[options.count++] = first_option;
 
+    options.items[0] = first_option;
     va_start(args, first_option);
-    next = NULL;
-    for (next = va_arg(args, Cstr); next != NULL;) {
-        options.items[options.count] = next;
-        next = va_arg(args, Cstr);
-        if(next != NULL) options.count++;
+    for (size_t i = 1; i < options.count; ++i) {
+        options.items[i] = va_arg(args, Cstr);
     }
-
     va_end(args);
 
-    while(true){
-        if(title != NULL){
-            printf("%s%s%s\n", COLOR_FG(color), title, RESET);
+    ClibMenuConfig config = {
+        .title = title,
+        .color = color,
+        .print_option = print_option,
+        .items = options.items,
+        .count = options.count,
+    };
+    int selected = clib_menu_select(&config);
+
+    free(options.items);
+    return selected;
+}
+
+#ifndef _WIN32
+// SIGWINCH writes to this pipe, so the resize wakes up poll
+static int clib__loop_wake[2] = { -1, -1 };
+static struct sigaction clib__loop_old_winch;
+
+static void clib__loop_on_winch(int signum){
+    (void) signum;
+    int saved = errno;
+    ssize_t written = write(clib__loop_wake[1], "w", 1);
+    (void) written;
+    errno = saved;
+}
+
+static int64_t clib__loop_now_ms(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+CLIBAPI int clib_loop_init(ClibLoop* loop){
+    *loop = (ClibLoop) {0};
+    for(size_t i = 0; i < CLIB_LOOP_MAX_FDS; ++i) loop->fds[i].fd = -1;
+
+    if(pipe(clib__loop_wake) != 0){
+        perror("pipe");
+        return -1;
+    }
+    for(int i = 0; i < 2; ++i){
+        fcntl(clib__loop_wake[i], F_SETFL, fcntl(clib__loop_wake[i], F_GETFL) | O_NONBLOCK);
+        fcntl(clib__loop_wake[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    struct sigaction action = {0};
+    action.sa_handler = clib__loop_on_winch;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &action, &clib__loop_old_winch);
+
+    clib_input_begin(&loop->input, STDIN_FILENO, true);
+    loop->input_open = true;
+    return 0;
+}
+
+CLIBAPI void clib_loop_free(ClibLoop* loop){
+    clib_input_end(&loop->input);
+    sigaction(SIGWINCH, &clib__loop_old_winch, NULL);
+
+    for(int i = 0; i < 2; ++i){
+        if(clib__loop_wake[i] >= 0) close(clib__loop_wake[i]);
+        clib__loop_wake[i] = -1;
+    }
+}
+
+CLIBAPI void clib_loop_on_key(ClibLoop* loop, ClibLoopKeyFunc func, void* ctx){
+    loop->on_key = func;
+    loop->key_ctx = ctx;
+}
+
+CLIBAPI void clib_loop_on_resize(ClibLoop* loop, ClibLoopResizeFunc func, void* ctx){
+    loop->on_resize = func;
+    loop->resize_ctx = ctx;
+}
+
+// Fires after delay_ms, then every interval_ms unless that is 0.
+// Returns the timer id, or -1 when every timer is in use.
+CLIBAPI int clib_loop_add_timer(ClibLoop* loop, int64_t delay_ms, int64_t interval_ms, ClibLoopTimerFunc func, void* ctx){
+    for(int i = 0; i < CLIB_LOOP_MAX_TIMERS; ++i){
+        if(loop->timers[i].active) continue;
+        loop->timers[i] = (ClibLoopTimer) {
+            .due_ms = clib__loop_now_ms() + delay_ms,
+            .interval_ms = interval_ms,
+            .func = func,
+            .ctx = ctx,
+            .active = true,
+        };
+        return i;
+    }
+    ERRO("Too many timers, the maximum is %d", CLIB_LOOP_MAX_TIMERS);
+    return -1;
+}
+
+CLIBAPI void clib_loop_remove_timer(ClibLoop* loop, int timer){
+    if(timer >= 0 && timer < CLIB_LOOP_MAX_TIMERS) loop->timers[timer].active = false;
+}
+
+CLIBAPI int clib_loop_add_fd(ClibLoop* loop, int fd, short events, ClibLoopFdFunc func, void* ctx){
+    for(size_t i = 0; i < CLIB_LOOP_MAX_FDS; ++i){
+        if(loop->fds[i].fd >= 0) continue;
+        loop->fds[i] = (ClibLoopFd) { .fd = fd, .events = events, .func = func, .ctx = ctx };
+        return 0;
+    }
+    ERRO("Too many file descriptors, the maximum is %d", CLIB_LOOP_MAX_FDS);
+    return -1;
+}
+
+CLIBAPI void clib_loop_remove_fd(ClibLoop* loop, int fd){
+    for(size_t i = 0; i < CLIB_LOOP_MAX_FDS; ++i){
+        if(loop->fds[i].fd == fd) loop->fds[i].fd = -1;
+    }
+}
+
+static void clib__loop_fire_timers(ClibLoop* loop){
+    int64_t now = clib__loop_now_ms();
+    for(int i = 0; i < CLIB_LOOP_MAX_TIMERS; ++i){
+        ClibLoopTimer* timer = &loop->timers[i];
+        if(!timer->active || timer->due_ms > now) continue;
+
+        // A late repeating timer skips the ticks it missed instead of bursting
+        if(timer->interval_ms > 0){
+            timer->due_ms += timer->interval_ms;
+            if(timer->due_ms <= now) timer->due_ms = now + timer->interval_ms;
+        } else {
+            timer->active = false;
         }
-        for(size_t i = 0; i < options.count; ++i){
-            print_option(options.items[i], selected == i, color);
-            printf("\n");
+        timer->func(loop, timer->ctx);
+    }
+}
+
+// Waits for events up to timeout_ms (-1 until one arrives, capped by the
+// next timer) and dispatches them. Returns -1 if poll fails.
+CLIBAPI int clib_loop_step(ClibLoop* loop, int timeout_ms){
+    int64_t now = clib__loop_now_ms();
+    for(int i = 0; i < CLIB_LOOP_MAX_TIMERS; ++i){
+        if(!loop->timers[i].active) continue;
+        int64_t wait = loop->timers[i].due_ms - now;
+        if(wait < 0) wait = 0;
+        if(timeout_ms < 0 || wait < timeout_ms) timeout_ms = (int) wait;
+    }
+
+    // Slot 0 is the keyboard and slot 1 the resize pipe. A negative fd is ignored by poll.
+    struct pollfd pfds[2 + CLIB_LOOP_MAX_FDS];
+    pfds[0] = (struct pollfd) { .fd = loop->input_open ? loop->input.fd : -1, .events = POLLIN };
+    pfds[1] = (struct pollfd) { .fd = clib__loop_wake[0], .events = POLLIN };
+    for(size_t i = 0; i < CLIB_LOOP_MAX_FDS; ++i){
+        pfds[2 + i] = (struct pollfd) { .fd = loop->fds[i].fd, .events = loop->fds[i].events };
+    }
+
+    // Keys already read with an earlier sequence do not need to wait
+    if(loop->input_open && loop->input.length > 0) timeout_ms = 0;
+
+    int ready = poll(pfds, 2 + CLIB_LOOP_MAX_FDS, timeout_ms);
+    if(ready < 0 && errno != EINTR){
+        perror("poll");
+        return -1;
+    }
+
+    if(ready > 0 && (pfds[1].revents & POLLIN)){
+        char drain[64];
+        while(read(clib__loop_wake[0], drain, sizeof(drain)) > 0);
+        if(loop->on_resize != NULL){
+            int columns, rows;
+            clib_term_size(&columns, &rows);
+            loop->on_resize(loop, columns, rows, loop->resize_ctx);
         }
-        
-        int pressed = clib_getch();
-        switch (pressed) {
-            case CLIB_KEY_ARROW_UP:
-                selected = clib_eu_mod((selected-1), options.count);
-                break;
-            case CLIB_KEY_ARROW_DOWN:
-                selected = clib_eu_mod((selected+1), options.count);
-                break;
-            case CLIB_KEY_ENTER:
-                clib_enable_input_buffering();
-                free(options.items);
-                return selected; 
-            default:
-                break;
+    }
+
+    if(loop->input_open && (loop->input.length > 0 || (ready > 0 && pfds[0].revents))){
+        int keys = 0, key;
+        while((key = clib_input_read(&loop->input, 0)) != CLIB_KEY_NONE){
+            keys++;
+            if(loop->on_key != NULL) loop->on_key(loop, key, loop->key_ctx);
         }
+        // Readable without any key means the input has ended
+        if(keys == 0 && pfds[0].revents) loop->input_open = false;
+    }
+
+    for(size_t i = 0; ready > 0 && i < CLIB_LOOP_MAX_FDS; ++i){
+        if(pfds[2 + i].revents == 0 || loop->fds[i].fd != pfds[2 + i].fd) continue;
+        loop->fds[i].func(loop, loop->fds[i].fd, pfds[2 + i].revents, loop->fds[i].ctx);
+    }
+
+    clib__loop_fire_timers(loop);
+    return 0;
+}
 
-        MOVE_CURSOR_UP(options.count + (title != NULL));
-        CLEAR_BELOW_CURSOR;
+// Dispatches events until clib_loop_stop is called
+CLIBAPI int clib_loop_run(ClibLoop* loop){
+    loop->running = true;
+    while(loop->running){
+        if(clib_loop_step(loop, -1) != 0) return -1;
     }
+    return 0;
+}
+
+CLIBAPI void clib_loop_stop(ClibLoop* loop){
+    loop->running = false;
 }
+#endif
 #endif // CLIB_MENUS
 
 CLIBAPI int clib_eu_mod(int a, int b){
@@ -853,260 +3507,3232 @@ CLIBAPI int clib_eu_mod(int a, int b){
     if (r < 0) {
         r += (b > 0) ? b : -b;
     }
-    return r;
+    return r;
+}
+
+CLIBAPI uint64_t clib_thread_id(){
+#ifdef __linux__
+    return (uint64_t) syscall(SYS_gettid);
+#elif !defined(_WIN32)
+    return (uint64_t) getpid();
+#else
+    return 0;
+#endif
+}
+
+// "00" to "99", so two digits are written per division
+static const char clib__digit_pairs[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9',
+};
+
+static const uint64_t clib__pow10[20] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+    10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+    100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+};
+
+// The bit length gives the digit count to within one, and one comparison settles it
+static size_t clib__count_digits(uint64_t value){
+    value |= 1; // zero takes a digit too, and no power of ten is odd
+    size_t estimate = ((64 - clib__clz64(value)) * 1233) >> 12;
+    return estimate + (value >= clib__pow10[estimate]);
+}
+
+// Pads with zeros up to min_width, which must not be over 20
+CLIBAPI size_t clib_u64toa_width(char* buffer, uint64_t value, size_t min_width){
+    size_t length = clib__count_digits(value);
+    if(length < min_width) length = min_width;
+
+    char* end = buffer + length;
+    *end = '\0';
+    while(value >= 100){
+        end -= 2;
+        memcpy(end, clib__digit_pairs + (value % 100) * 2, 2);
+        value /= 100;
+    }
+    if(value >= 10){
+        end -= 2;
+        memcpy(end, clib__digit_pairs + value * 2, 2);
+    } else {
+        *--end = '0' + value;
+    }
+    while(end > buffer) *--end = '0';
+
+    return length;
+}
+
+CLIBAPI size_t clib_u64toa(char* buffer, uint64_t value){
+    return clib_u64toa_width(buffer, value, 0);
+}
+
+CLIBAPI size_t clib_i64toa(char* buffer, int64_t value){
+    if(value >= 0) return clib_u64toa(buffer, value);
+
+    *buffer = '-';
+    return 1 + clib_u64toa(buffer + 1, 0 - (uint64_t) value);
+}
+
+// Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+// with Integers"): the digits are generated with 64-bit integer arithmetic
+// against a cached power of ten. They always read back as the same double,
+// but are not always the shortest digits that do.
+typedef struct {
+    uint64_t f;
+    int e;
+} ClibDiyFp;
+
+// 10^k for k = -348, -340, ..., 340, normalized to a 64-bit significand
+static const ClibDiyFp clib__cached_powers[87] = {
+    { 0xfa8fd5a0081c0288ull, -1220 }, { 0xbaaee17fa23ebf76ull, -1193 }, { 0x8b16fb203055ac76ull, -1166 },
+    { 0xcf42894a5dce35eaull, -1140 }, { 0x9a6bb0aa55653b2dull, -1113 }, { 0xe61acf033d1a45dfull, -1087 },
+    { 0xab70fe17c79ac6caull, -1060 }, { 0xff77b1fcbebcdc4full, -1034 }, { 0xbe5691ef416bd60cull, -1007 },
+    { 0x8dd01fad907ffc3cull, -980 }, { 0xd3515c2831559a83ull, -954 }, { 0x9d71ac8fada6c9b5ull, -927 },
+    { 0xea9c227723ee8bcbull, -901 }, { 0xaecc49914078536dull, -874 }, { 0x823c12795db6ce57ull, -847 },
+    { 0xc21094364dfb5637ull, -821 }, { 0x9096ea6f3848984full, -794 }, { 0xd77485cb25823ac7ull, -768 },
+    { 0xa086cfcd97bf97f4ull, -741 }, { 0xef340a98172aace5ull, -715 }, { 0xb23867fb2a35b28eull, -688 },
+    { 0x84c8d4dfd2c63f3bull, -661 }, { 0xc5dd44271ad3cdbaull, -635 }, { 0x936b9fcebb25c996ull, -608 },
+    { 0xdbac6c247d62a584ull, -582 }, { 0xa3ab66580d5fdaf6ull, -555 }, { 0xf3e2f893dec3f126ull, -529 },
+    { 0xb5b5ada8aaff80b8ull, -502 }, { 0x87625f056c7c4a8bull, -475 }, { 0xc9bcff6034c13053ull, -449 },
+    { 0x964e858c91ba2655ull, -422 }, { 0xdff9772470297ebdull, -396 }, { 0xa6dfbd9fb8e5b88full, -369 },
+    { 0xf8a95fcf88747d94ull, -343 }, { 0xb94470938fa89bcfull, -316 }, { 0x8a08f0f8bf0f156bull, -289 },
+    { 0xcdb02555653131b6ull, -263 }, { 0x993fe2c6d07b7facull, -236 }, { 0xe45c10c42a2b3b06ull, -210 },
+    { 0xaa242499697392d3ull, -183 }, { 0xfd87b5f28300ca0eull, -157 }, { 0xbce5086492111aebull, -130 },
+    { 0x8cbccc096f5088ccull, -103 }, { 0xd1b71758e219652cull, -77 }, { 0x9c40000000000000ull, -50 },
+    { 0xe8d4a51000000000ull, -24 }, { 0xad78ebc5ac620000ull, 3 }, { 0x813f3978f8940984ull, 30 },
+    { 0xc097ce7bc90715b3ull, 56 }, { 0x8f7e32ce7bea5c70ull, 83 }, { 0xd5d238a4abe98068ull, 109 },
+    { 0x9f4f2726179a2245ull, 136 }, { 0xed63a231d4c4fb27ull, 162 }, { 0xb0de65388cc8ada8ull, 189 },
+    { 0x83c7088e1aab65dbull, 216 }, { 0xc45d1df942711d9aull, 242 }, { 0x924d692ca61be758ull, 269 },
+    { 0xda01ee641a708deaull, 295 }, { 0xa26da3999aef774aull, 322 }, { 0xf209787bb47d6b85ull, 348 },
+    { 0xb454e4a179dd1877ull, 375 }, { 0x865b86925b9bc5c2ull, 402 }, { 0xc83553c5c8965d3dull, 428 },
+    { 0x952ab45cfa97a0b3ull, 455 }, { 0xde469fbd99a05fe3ull, 481 }, { 0xa59bc234db398c25ull, 508 },
+    { 0xf6c69a72a3989f5cull, 534 }, { 0xb7dcbf5354e9beceull, 561 }, { 0x88fcf317f22241e2ull, 588 },
+    { 0xcc20ce9bd35c78a5ull, 614 }, { 0x98165af37b2153dfull, 641 }, { 0xe2a0b5dc971f303aull, 667 },
+    { 0xa8d9d1535ce3b396ull, 694 }, { 0xfb9b7cd9a4a7443cull, 720 }, { 0xbb764c4ca7a44410ull, 747 },
+    { 0x8bab8eefb6409c1aull, 774 }, { 0xd01fef10a657842cull, 800 }, { 0x9b10a4e5e9913129ull, 827 },
+    { 0xe7109bfba19c0c9dull, 853 }, { 0xac2820d9623bf429ull, 880 }, { 0x80444b5e7aa7cf85ull, 907 },
+    { 0xbf21e44003acdd2dull, 933 }, { 0x8e679c2f5e44ff8full, 960 }, { 0xd433179d9c8cb841ull, 986 },
+    { 0x9e19db92b4e31ba9ull, 1013 }, { 0xeb96bf6ebadf77d9ull, 1039 }, { 0xaf87023b9bf0ee6bull, 1066 },
+};
+
+static ClibDiyFp clib__diyfp_multiply(ClibDiyFp x, ClibDiyFp y){
+    uint64_t high;
+    uint64_t low = clib__mul_u64(x.f, y.f, &high);
+    return (ClibDiyFp) { high + (low >> 63), x.e + y.e + 64 };
+}
+
+static ClibDiyFp clib__diyfp_normalize(ClibDiyFp x){
+    int shift = clib__clz64(x.f);
+    return (ClibDiyFp) { x.f << shift, x.e - shift };
+}
+
+static void clib__grisu_round(char* buffer, size_t length, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w){
+    while(rest < wp_w && delta - rest >= ten_kappa &&
+          (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)){
+        buffer[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+// Writes the digits of a positive, finite value and returns their count.
+// The value is digits * 10^(*exponent).
+static size_t clib__grisu2(double value, char* buffer, int* exponent){
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint64_t hidden = 1ull << 52;
+    uint64_t significand = bits & (hidden - 1);
+    int biased = (int) ((bits >> 52) & 0x7ff);
+
+    ClibDiyFp v = biased != 0
+        ? (ClibDiyFp) { significand + hidden, biased - 1075 }
+        : (ClibDiyFp) { significand, -1074 };
+
+    // The boundaries halfway to the neighbouring doubles
+    ClibDiyFp plus = clib__diyfp_normalize((ClibDiyFp) { (v.f << 1) + 1, v.e - 1 });
+    ClibDiyFp minus = v.f == hidden
+        ? (ClibDiyFp) { (v.f << 2) - 1, v.e - 2 }
+        : (ClibDiyFp) { (v.f << 1) - 1, v.e - 1 };
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    // A power of ten that brings the exponent into [-60, -32]
+    double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+    int k = (int) dk;
+    if(dk - k > 0.0) k++;
+    size_t index = (size_t) ((k >> 3) + 1);
+    *exponent = -(-348 + (int) index * 8);
+    ClibDiyFp cached = clib__cached_powers[index];
+
+    ClibDiyFp w = clib__diyfp_multiply(clib__diyfp_normalize(v), cached);
+    ClibDiyFp wp = clib__diyfp_multiply(plus, cached);
+    ClibDiyFp wm = clib__diyfp_multiply(minus, cached);
+    wm.f++;
+    wp.f--;
+
+    uint64_t delta = wp.f - wm.f;
+    uint64_t wp_w = wp.f - w.f;
+    ClibDiyFp one = { 1ull << -wp.e, wp.e };
+    uint32_t p1 = (uint32_t) (wp.f >> -one.e);
+    uint64_t p2 = wp.f & (one.f - 1);
+    int kappa = (int) clib__count_digits(p1);
+    size_t length = 0;
+
+    while(kappa > 0){
+        uint32_t digit = p1 / clib__pow10[kappa - 1];
+        p1 %= clib__pow10[kappa - 1];
+        if(digit != 0 || length != 0) buffer[length++] = '0' + digit;
+        kappa--;
+
+        uint64_t rest = ((uint64_t) p1 << -one.e) + p2;
+        if(rest <= delta){
+            *exponent += kappa;
+            clib__grisu_round(buffer, length, delta, rest, clib__pow10[kappa] << -one.e, wp_w);
+            return length;
+        }
+    }
+
+    while(true){
+        p2 *= 10;
+        delta *= 10;
+        char digit = (char) (p2 >> -one.e);
+        if(digit != 0 || length != 0) buffer[length++] = '0' + digit;
+        p2 &= one.f - 1;
+        kappa--;
+
+        if(p2 < delta){
+            *exponent += kappa;
+            clib__grisu_round(buffer, length, delta, p2, one.f, -kappa < 20 ? wp_w * clib__pow10[-kappa] : 0);
+            return length;
+        }
+    }
+}
+
+// Formats the value the way JavaScript prints numbers, without an exponent
+// between 1e-6 and 1e21. The digits always read back as the same double and
+// are the fewest that do in all but rare cases, where one more is written.
+// buffer must hold CLIB_DTOA_SIZE bytes.
+CLIBAPI size_t clib_dtoa(char* buffer, double value){
+    char* out = buffer;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    if(value != value){
+        memcpy(buffer, "nan", 4);
+        return 3;
+    }
+    if(bits >> 63){
+        *out++ = '-';
+        value = -value;
+    }
+    if(value == 0){
+        memcpy(out, "0", 2);
+        return out + 1 - buffer;
+    }
+    if(value > 1.7976931348623157e308){
+        memcpy(out, "inf", 4);
+        return out + 3 - buffer;
+    }
+
+    char digits[20];
+    int exponent;
+    int length = (int) clib__grisu2(value, digits, &exponent);
+    int point = length + exponent; // the decimal point goes after this many digits
+
+    if(exponent >= 0 && point <= 21){
+        // 1234e5 -> 123400000
+        memcpy(out, digits, length);
+        memset(out + length, '0', exponent);
+        out += point;
+    }
+    else if(point > 0 && point <= 21){
+        // 1234e-2 -> 12.34
+        memcpy(out, digits, point);
+        out[point] = '.';
+        memcpy(out + point + 1, digits + point, length - point);
+        out += length + 1;
+    }
+    else if(point > -6 && point <= 0){
+        // 1234e-6 -> 0.001234
+        memcpy(out, "0.", 2);
+        memset(out + 2, '0', -point);
+        memcpy(out + 2 - point, digits, length);
+        out += 2 - point + length;
+    }
+    else {
+        // 1234e30 -> 1.234e+33
+        *out++ = digits[0];
+        if(length > 1){
+            *out++ = '.';
+            memcpy(out, digits + 1, length - 1);
+            out += length - 1;
+        }
+        *out++ = 'e';
+        *out++ = point - 1 < 0 ? '-' : '+';
+        out += clib_u64toa(out, point - 1 < 0 ? 1 - point : point - 1);
+    }
+
+    *out = '\0';
+    return out - buffer;
+}
+
+static int clib__simd_detected = -1;
+static int clib__simd_limit = CLIB_SIMD_AVX2;
+
+CLIBAPI ClibSimdLevel clib_simd_level(){
+    if(clib__simd_detected < 0){
+#ifdef CLIB_STR_SIMD
+        __builtin_cpu_init();
+        clib__simd_detected = __builtin_cpu_supports("avx2") ? CLIB_SIMD_AVX2 : CLIB_SIMD_SSE2;
+#else
+        clib__simd_detected = CLIB_SIMD_NONE;
+#endif
+    }
+    return clib__simd_detected < clib__simd_limit ? clib__simd_detected : clib__simd_limit;
+}
+
+// Caps the kernels to `level`, to compare them or rule one out
+CLIBAPI void clib_simd_set_level(ClibSimdLevel level){
+    clib__simd_limit = level;
+}
+
+// Scalar kernels, which also finish the tails of the vector ones
+
+static size_t clib__str_find_any_scalar(const char* data, size_t length, CstrView set){
+    uint8_t table[256] = {0};
+    for(size_t i = 0; i < set.length; ++i) table[(uint8_t) set.data[i]] = 1;
+
+    for(size_t i = 0; i < length; ++i){
+        if(table[(uint8_t) data[i]]) return i;
+    }
+    return CLIB_STR_NPOS;
+}
+
+static size_t clib__str_count_byte_scalar(const char* data, size_t length, char byte){
+    size_t count = 0;
+    for(size_t i = 0; i < length; ++i) count += data[i] == byte;
+    return count;
+}
+
+static void clib__str_fold_scalar(char* data, size_t length, char from, char flip){
+    for(size_t i = 0; i < length; ++i){
+        if((unsigned char) (data[i] - from) < 26) data[i] ^= flip;
+    }
+}
+
+static size_t clib__str_ascii_scalar(const char* data, size_t length){
+    size_t i = 0;
+    while(i < length && (unsigned char) data[i] < 0x80) i++;
+    return i;
+}
+
+static size_t clib__str_find_scalar(const char* data, size_t length, CstrView needle){
+    if(needle.length > length) return CLIB_STR_NPOS;
+
+    size_t last = length - needle.length;
+    for(size_t i = 0; i <= last; ){
+        const char* first = (const char*) memchr(data + i, needle.data[0], last - i + 1);
+        if(first == NULL) return CLIB_STR_NPOS;
+
+        i = first - data;
+        if(memcmp(data + i + 1, needle.data + 1, needle.length - 1) == 0) return i;
+        i++;
+    }
+    return CLIB_STR_NPOS;
+}
+
+#ifdef CLIB_STR_SIMD
+// The SSE2 and AVX2 kernels are the same loop over 16 or 32 bytes
+#define CLIB__SIMD_KERNELS(suffix, target, vec, width, load, set1, cmpeq, or_, and_, xor_, add, cmplt, movemask) \
+    target static size_t clib__str_find_any_##suffix(const char* data, size_t length, CstrView set){ \
+        vec bytes[16]; \
+        for(size_t j = 0; j < set.length; ++j) bytes[j] = set1(set.data[j]); \
+        size_t i = 0; \
+        for(; i + width <= length; i += width){ \
+            vec chunk = load((const vec*) (data + i)); \
+            vec hits = cmpeq(chunk, bytes[0]); \
+            for(size_t j = 1; j < set.length; ++j) hits = or_(hits, cmpeq(chunk, bytes[j])); \
+            uint32_t mask = (uint32_t) movemask(hits); \
+            if(mask) return i + clib__ctz32(mask); \
+        } \
+        size_t found = clib__str_find_any_scalar(data + i, length - i, set); \
+        return found == CLIB_STR_NPOS ? found : i + found; \
+    } \
+    \
+    target static size_t clib__str_count_byte_##suffix(const char* data, size_t length, char byte){ \
+        vec needle = set1(byte); \
+        size_t count = 0, i = 0; \
+        for(; i + width <= length; i += width){ \
+            count += __builtin_popcount((uint32_t) movemask(cmpeq(load((const vec*) (data + i)), needle))); \
+        } \
+        return count + clib__str_count_byte_scalar(data + i, length - i, byte); \
+    } \
+    \
+    /* Bytes from `from` to `from + 25` have `flip` toggled: shifted to the */ \
+    /* bottom of the signed range, they are the ones below -128 + 26 */ \
+    target static void clib__str_fold_##suffix(char* data, size_t length, char from, char flip){ \
+        vec shift = set1((char) (128 - from)); \
+        vec bound = set1((char) (-128 + 26)); \
+        vec bit = set1(flip); \
+        size_t i = 0; \
+        for(; i + width <= length; i += width){ \
+            vec chunk = load((const vec*) (data + i)); \
+            vec in_range = cmplt(add(chunk, shift), bound); \
+            clib__str_store_##suffix(data + i, xor_(chunk, and_(in_range, bit))); \
+        } \
+        clib__str_fold_scalar(data + i, length - i, from, flip); \
+    } \
+    \
+    target static size_t clib__str_ascii_##suffix(const char* data, size_t length){ \
+        size_t i = 0; \
+        for(; i + width <= length; i += width){ \
+            uint32_t mask = (uint32_t) movemask(load((const vec*) (data + i))); \
+            if(mask) return i + clib__ctz32(mask); \
+        } \
+        return i + clib__str_ascii_scalar(data + i, length - i); \
+    } \
+    \
+    /* Compares the first and last byte of the needle at every offset at */ \
+    /* once, and only calls memcmp where both match */ \
+    target static size_t clib__str_find_##suffix(const char* data, size_t length, CstrView needle){ \
+        if(needle.length > length) return CLIB_STR_NPOS; \
+        vec first = set1(needle.data[0]); \
+        vec last = set1(needle.data[needle.length - 1]); \
+        size_t i = 0; \
+        for(; i + needle.length - 1 + width <= length; i += width){ \
+            vec starts = cmpeq(load((const vec*) (data + i)), first); \
+            vec ends = cmpeq(load((const vec*) (data + i + needle.length - 1)), last); \
+            uint32_t mask = (uint32_t) movemask(and_(starts, ends)); \
+            while(mask){ \
+                size_t at = i + clib__ctz32(mask); \
+                if(memcmp(data + at + 1, needle.data + 1, needle.length - 2) == 0) return at; \
+                mask &= mask - 1; \
+            } \
+        } \
+        size_t found = clib__str_find_scalar(data + i, length - i, needle); \
+        return found == CLIB_STR_NPOS ? found : i + found; \
+    }
+
+static inline void clib__str_store_sse2(char* data, __m128i value){
+    _mm_storeu_si128((__m128i*) data, value);
+}
+
+__attribute__((target("avx2")))
+static inline void clib__str_store_avx2(char* data, __m256i value){
+    _mm256_storeu_si256((__m256i*) data, value);
+}
+
+CLIB__SIMD_KERNELS(sse2, , __m128i, 16, _mm_loadu_si128, _mm_set1_epi8, _mm_cmpeq_epi8,
+    _mm_or_si128, _mm_and_si128, _mm_xor_si128, _mm_add_epi8, _mm_cmplt_epi8, _mm_movemask_epi8)
+
+#define clib__mm256_cmplt_epi8(a, b) _mm256_cmpgt_epi8(b, a)
+CLIB__SIMD_KERNELS(avx2, __attribute__((target("avx2"))), __m256i, 32, _mm256_loadu_si256, _mm256_set1_epi8, _mm256_cmpeq_epi8,
+    _mm256_or_si256, _mm256_and_si256, _mm256_xor_si256, _mm256_add_epi8, clib__mm256_cmplt_epi8, _mm256_movemask_epi8)
+
+// Calls the widest kernel the CPU has
+#define CLIB__SIMD_DISPATCH(kernel, ...) \
+    switch(clib_simd_level()){ \
+        case CLIB_SIMD_AVX2: return kernel##_avx2(__VA_ARGS__); \
+        case CLIB_SIMD_SSE2: return kernel##_sse2(__VA_ARGS__); \
+        default: return kernel##_scalar(__VA_ARGS__); \
+    }
+#else
+#define CLIB__SIMD_DISPATCH(kernel, ...) return kernel##_scalar(__VA_ARGS__);
+#endif // CLIB_STR_SIMD
+
+// Returns where needle starts in text, or CLIB_STR_NPOS
+CLIBAPI size_t clib_str_find(CstrView text, CstrView needle){
+    if(needle.length == 0) return 0;
+    if(needle.length == 1){
+        const char* found = (const char*) memchr(text.data, needle.data[0], text.length);
+        return found ? (size_t) (found - text.data) : CLIB_STR_NPOS;
+    }
+    CLIB__SIMD_DISPATCH(clib__str_find, text.data, text.length, needle);
+}
+
+// Returns where the first byte that is in set is, or CLIB_STR_NPOS.
+// Sets of more than 16 bytes are searched through a table instead.
+CLIBAPI size_t clib_str_find_any(CstrView text, CstrView set){
+    if(set.length == 0) return CLIB_STR_NPOS;
+    if(set.length == 1) return clib_str_find(text, set);
+    if(set.length > 16) return clib__str_find_any_scalar(text.data, text.length, set);
+    CLIB__SIMD_DISPATCH(clib__str_find_any, text.data, text.length, set);
+}
+
+CLIBAPI size_t clib_str_count_byte(CstrView text, char byte){
+    CLIB__SIMD_DISPATCH(clib__str_count_byte, text.data, text.length, byte);
+}
+
+// A last line without a newline counts too
+CLIBAPI size_t clib_str_count_lines(CstrView text){
+    if(text.length == 0) return 0;
+    return clib_str_count_byte(text, '\n') + (text.data[text.length - 1] != '\n');
+}
+
+// Takes the part of rest up to the next delimiter and moves rest past it.
+// Returns false once every part has been taken.
+CLIBAPI int clib_str_split_next(CstrView* rest, CstrView delimiter, CstrView* part){
+    if(rest->data == NULL) return false;
+
+    size_t at = delimiter.length > 0 ? clib_str_find(*rest, delimiter) : CLIB_STR_NPOS;
+    if(at == CLIB_STR_NPOS){
+        *part = *rest;
+        *rest = (CstrView) { NULL, 0 };
+        return true;
+    }
+
+    *part = (CstrView) { rest->data, at };
+    rest->data += at + delimiter.length;
+    rest->length -= at + delimiter.length;
+    return true;
+}
+
+CLIBAPI CstrView clib_str_trim(CstrView text){
+    static const uint8_t space[256] = { [' '] = 1, ['\t'] = 1, ['\n'] = 1, ['\v'] = 1, ['\f'] = 1, ['\r'] = 1 };
+
+    while(text.length > 0 && space[(uint8_t) text.data[0]]){
+        text.data++;
+        text.length--;
+    }
+    while(text.length > 0 && space[(uint8_t) text.data[text.length - 1]]) text.length--;
+    return text;
+}
+
+// Returns a NUL-terminated copy of text with every `from` replaced by `to`.
+// The caller frees it. length, when not NULL, receives its length.
+CLIBAPI char* clib_str_replace(CstrView text, CstrView from, CstrView to, size_t* length){
+    size_t count = 0;
+    CstrView rest = text;
+    while(from.length > 0){
+        size_t at = clib_str_find(rest, from);
+        if(at == CLIB_STR_NPOS) break;
+        count++;
+        rest.data += at + from.length;
+        rest.length -= at + from.length;
+    }
+
+    size_t size = text.length - count * from.length + count * to.length;
+    char* result = (char*) clib_safe_malloc(size + 1);
+    char* out = result;
+
+    rest = text;
+    for(size_t i = 0; i < count; ++i){
+        size_t at = clib_str_find(rest, from);
+        memcpy(out, rest.data, at);
+        memcpy(out + at, to.data, to.length);
+        out += at + to.length;
+        rest.data += at + from.length;
+        rest.length -= at + from.length;
+    }
+    memcpy(out, rest.data, rest.length);
+    result[size] = '\0';
+
+    if(length != NULL) *length = size;
+    return result;
+}
+
+// ASCII letters only, in place
+CLIBAPI void clib_str_to_lower(char* data, size_t length){
+    CLIB__SIMD_DISPATCH(clib__str_fold, data, length, 'A', 0x20);
+}
+
+CLIBAPI void clib_str_to_upper(char* data, size_t length){
+    CLIB__SIMD_DISPATCH(clib__str_fold, data, length, 'a', 0x20);
+}
+
+static size_t clib__str_ascii(const char* data, size_t length){
+    CLIB__SIMD_DISPATCH(clib__str_ascii, data, length);
+}
+
+// Rejects overlong forms, surrogates and code points past U+10FFFF
+CLIBAPI int clib_str_valid_utf8(CstrView text){
+    const unsigned char* data = (const unsigned char*) text.data;
+    size_t i = 0;
+
+    while(i < text.length){
+        // Runs of ASCII are skipped a vector at a time
+        if(data[i] < 0x80){
+            i += clib__str_ascii(text.data + i, text.length - i);
+            continue;
+        }
+
+        unsigned char c = data[i];
+        size_t size;
+        unsigned char low = 0x80, high = 0xbf; // range of the second byte
+        if(c >= 0xc2 && c <= 0xdf) size = 2;
+        else if(c >= 0xe0 && c <= 0xef) {
+            size = 3;
+            if(c == 0xe0) low = 0xa0;
+            if(c == 0xed) high = 0x9f;
+        }
+        else if(c >= 0xf0 && c <= 0xf4) {
+            size = 4;
+            if(c == 0xf0) low = 0x90;
+            if(c == 0xf4) high = 0x8f;
+        }
+        else return false;
+
+        if(i + size > text.length) return false;
+        if(data[i + 1] < low || data[i + 1] > high) return false;
+        for(size_t j = 2; j < size; ++j){
+            if((data[i + j] & 0xc0) != 0x80) return false;
+        }
+        i += size;
+    }
+    return true;
+}
+
+CLIB_HASHMAP_IMPL(ClibInternMap, clib__intern_map, CstrView, uint32_t, clib_hash_view, clib_view_equal)
+
+CLIBAPI void clib_interner_init(ClibInterner* interner){
+    *interner = (ClibInterner) {0};
+    clib__intern_map_init(&interner->map);
+}
+
+CLIBAPI void clib_interner_free(ClibInterner* interner){
+    while(interner->chunk != NULL){
+        char* previous;
+        memcpy(&previous, interner->chunk, sizeof(previous));
+        free(interner->chunk);
+        interner->chunk = previous;
+    }
+    clib__intern_map_free(&interner->map);
+    free(interner->strings);
+    *interner = (ClibInterner) {0};
+}
+
+// Copies text and a NUL into the arena. Chunks are never moved, so earlier
+// strings keep their address.
+static Cstr clib__intern_copy(ClibInterner* interner, CstrView text){
+    size_t size = text.length + 1;
+    if(interner->chunk == NULL || interner->chunk_used + size > interner->chunk_size){
+        size_t chunk_size = sizeof(char*) + size > CLIB_INTERN_CHUNK ? sizeof(char*) + size : CLIB_INTERN_CHUNK;
+        char* chunk = (char*) clib_safe_malloc(chunk_size);
+        memcpy(chunk, &interner->chunk, sizeof(char*));
+
+        interner->chunk = chunk;
+        interner->chunk_used = sizeof(char*);
+        interner->chunk_size = chunk_size;
+    }
+
+    char* copy = interner->chunk + interner->chunk_used;
+    memcpy(copy, text.data, text.length);
+    copy[text.length] = '\0';
+    interner->chunk_used += size;
+    return copy;
+}
+
+// Returns the ID of text, interning it if it is new
+CLIBAPI uint32_t clib_intern(ClibInterner* interner, CstrView text){
+    int existed;
+    ClibInternMapEntry* entry = clib__intern_map_emplace(&interner->map, text, &existed);
+    if(existed) return entry->value;
+
+    // Slot 0 stays unused, so IDs are their own index
+    if(interner->count + 1 >= interner->capacity){
+        interner->capacity = interner->capacity ? interner->capacity * 2 : 64;
+        interner->strings = (CstrView*) clib_safe_realloc(interner->strings, interner->capacity * sizeof(CstrView));
+    }
+
+    // The key has to point at the copy, not at the caller's text
+    entry->key = (CstrView) { clib__intern_copy(interner, text), text.length };
+    entry->value = ++interner->count;
+    interner->strings[entry->value] = entry->key;
+    return entry->value;
+}
+
+// Returns the ID of text, or CLIB_INTERN_NONE when it was never interned
+CLIBAPI uint32_t clib_intern_find(const ClibInterner* interner, CstrView text){
+    uint32_t* id = clib__intern_map_get(&interner->map, text);
+    return id ? *id : CLIB_INTERN_NONE;
+}
+
+CLIBAPI char* clib_shift_args(int *argc, char ***argv) {
+    assert(*argc > 0);
+    char *result = **argv;
+    *argc -= 1;
+    *argv += 1;
+    return result;
+}
+
+#define CLIB__COLOR_FG(n) "\e[38;5;" #n "m",
+#define CLIB__COLOR_BG(n) "\e[48;5;" #n "m",
+#define CLIB__COLOR_LENGTH(n) sizeof("\e[38;5;" #n "m") - 1,
+#define CLIB__DIGITS(n) #n,
+#define CLIB__DIGITS_LENGTH(n) sizeof(#n) - 1,
+
+static const Cstr clib__colors[2][256] = {
+    { CLIB__BYTE_VALUES(CLIB__COLOR_FG) },
+    { CLIB__BYTE_VALUES(CLIB__COLOR_BG) },
+};
+static const uint8_t clib__color_lengths[256] = { CLIB__BYTE_VALUES(CLIB__COLOR_LENGTH) };
+
+// Decimal text of every byte, padded to 4 so it can be copied with one fixed-size memcpy
+static const char clib__byte_digits[256][4] = { CLIB__BYTE_VALUES(CLIB__DIGITS) };
+static const uint8_t clib__byte_digits_lengths[256] = { CLIB__BYTE_VALUES(CLIB__DIGITS_LENGTH) };
+
+// The returned string is static, do not free it
+CLIBAPI Cstr clib_color(int color, int bg) {
+    if (color < 0 || color > 255) return "";
+
+    return clib__colors[bg != 0][color];
+}
+
+CLIBAPI CstrView clib_color_view(int color, int bg) {
+    if (color < 0 || color > 255) return (CstrView) { "", 0 };
+
+    return (CstrView) { clib__colors[bg != 0][color], clib__color_lengths[color] };
+}
+
+static inline char* clib__write_byte(char* buffer, uint8_t value){
+    memcpy(buffer, clib__byte_digits[value], 4);
+    return buffer + clib__byte_digits_lengths[value];
+}
+
+// Writes a truecolor sequence into `buffer`, which must hold at least
+// CLIB_COLOR_RGB_SIZE bytes, and returns its length
+CLIBAPI size_t clib_color_rgb(char* buffer, uint8_t r, uint8_t g, uint8_t b, int bg) {
+    static const char prefixes[2][8] = { "\e[38;2;", "\e[48;2;" };
+
+    char* end = buffer;
+    memcpy(end, prefixes[bg != 0], 7);
+    end = clib__write_byte(end + 7, r);
+    *end++ = ';';
+    end = clib__write_byte(end, g);
+    *end++ = ';';
+    end = clib__write_byte(end, b);
+    *end++ = 'm';
+    *end = '\0';
+
+    return end - buffer;
+}
+
+static ClibTermBuf* clib__term_active = NULL;
+
+CLIBAPI void clib_termbuf_init(ClibTermBuf* tb, int fd){
+    *tb = (ClibTermBuf) { .fd = fd, .sync = clib_term_supports_sync() };
+}
+
+CLIBAPI void clib_termbuf_free(ClibTermBuf* tb){
+    free(tb->data);
+    *tb = (ClibTermBuf) { .fd = tb->fd };
+}
+
+static void clib__termbuf_reserve(ClibTermBuf* tb, size_t extra){
+    if(tb->length + extra <= tb->capacity) return;
+
+    size_t capacity = tb->capacity ? tb->capacity : 4096;
+    while(capacity < tb->length + extra) capacity *= 2;
+    tb->data = (char*) clib_safe_realloc(tb->data, capacity);
+    tb->capacity = capacity;
+}
+
+// Only a full reset (`0` or no parameter, optionally with `39`/`49`) counts
+static int clib__sgr_is_reset(Cstr params, size_t length){
+    int full = length == 0;
+    for(size_t i = 0; i < length; ){
+        size_t j = i;
+        while(j < length && params[j] != ';') j++;
+
+        if(j - i == 0 || (j - i == 1 && params[i] == '0')) full = true;
+        else if(!(j - i == 2 && (params[i] == '3' || params[i] == '4') && params[i + 1] == '9')) return false;
+        i = j + 1;
+    }
+    return full;
+}
+
+// Drops the SGR sequences appended since `start` that would not change
+// anything: resets while nothing is styled and repeats of the active one
+static void clib__termbuf_coalesce(ClibTermBuf* tb, size_t start){
+    char* data = tb->data;
+    size_t read = start, write = start;
+
+    while(read < tb->length){
+        char* escape = (char*) memchr(data + read, '\e', tb->length - read);
+        size_t text_end = escape ? (size_t) (escape - data) : tb->length;
+
+        memmove(data + write, data + read, text_end - read);
+        write += text_end - read;
+        read = text_end;
+        if(escape == NULL) break;
+
+        size_t end = read + 1;
+        if(end < tb->length && data[end] == '['){
+            end++;
+            while(end < tb->length && ((data[end] >= '0' && data[end] <= '9') || data[end] == ';')) end++;
+        }
+
+        if(end >= tb->length || data[read + 1] != '[' || data[end] != 'm'){
+            data[write++] = data[read++];
+            continue;
+        }
+
+        size_t length = end + 1 - read;
+        int keep = true;
+        if(clib__sgr_is_reset(data + read + 2, length - 3)){
+            keep = tb->styled;
+            tb->styled = false;
+            tb->last_sgr[0] = '\0';
+        } else if(length < sizeof(tb->last_sgr)){
+            keep = !tb->styled || strncmp(tb->last_sgr, data + read, length) != 0 || tb->last_sgr[length] != '\0';
+            memcpy(tb->last_sgr, data + read, length);
+            tb->last_sgr[length] = '\0';
+            tb->styled = true;
+        } else {
+            tb->last_sgr[0] = '\0';
+            tb->styled = true;
+        }
+
+        if(keep){
+            memmove(data + write, data + read, length);
+            write += length;
+        }
+        read += length;
+    }
+
+    tb->length = write;
+}
+
+CLIBAPI void clib_termbuf_write(ClibTermBuf* tb, Cstr data, size_t length){
+    clib__termbuf_reserve(tb, length);
+    size_t start = tb->length;
+    memcpy(tb->data + start, data, length);
+    tb->length += length;
+
+    clib__termbuf_coalesce(tb, start);
+}
+
+static void clib__termbuf_vprintf(ClibTermBuf* tb, Cstr format, va_list args){
+    va_list copy;
+    va_copy(copy, args);
+
+    clib__termbuf_reserve(tb, 256);
+    size_t start = tb->length;
+    int length = vsnprintf(tb->data + start, tb->capacity - start, format, args);
+    if(length < 0){
+        va_end(copy);
+        return;
+    }
+
+    if(start + length >= tb->capacity){
+        clib__termbuf_reserve(tb, length + 1);
+        vsnprintf(tb->data + start, tb->capacity - start, format, copy);
+    }
+    va_end(copy);
+
+    tb->length += length;
+    clib__termbuf_coalesce(tb, start);
+}
+
+CLIBAPI void clib_termbuf_printf(ClibTermBuf* tb, Cstr format, ...){
+    va_list args;
+    va_start(args, format);
+    clib__termbuf_vprintf(tb, format, args);
+    va_end(args);
+}
+
+CLIBAPI void clib_termbuf_flush(ClibTermBuf* tb){
+    if(tb->length == 0) return;
+
+    // Anything still sitting in stdio has to go out first
+    fflush(stdout);
+#ifdef _WIN32
+    fwrite(tb->data, 1, tb->length, stdout);
+    fflush(stdout);
+#else
+    size_t written = 0;
+    while(written < tb->length){
+        ssize_t n = write(tb->fd, tb->data + written, tb->length - written);
+        if(n < 0){
+            if(errno == EINTR) continue;
+            break;
+        }
+        written += n;
+    }
+#endif
+    tb->length = 0;
+}
+
+// Synchronized updates (mode 2026) are only turned on for terminals known to
+// support them. CLIB_SYNC_UPDATE=0/1 overrides the guess.
+CLIBAPI int clib_term_supports_sync(){
+    Cstr override = getenv("CLIB_SYNC_UPDATE");
+    if(override) return strcmp(override, "0") != 0;
+
+    Cstr term = getenv("TERM");
+    Cstr program = getenv("TERM_PROGRAM");
+
+    if(getenv("WT_SESSION") || getenv("KITTY_WINDOW_ID")) return true;
+    if(program && (strcmp(program, "WezTerm") == 0 || strcmp(program, "iTerm.app") == 0 || strcmp(program, "ghostty") == 0)) return true;
+    if(term && (strstr(term, "kitty") || strstr(term, "foot") || strstr(term, "alacritty") || strstr(term, "contour") || strstr(term, "ghostty"))) return true;
+
+    return false;
+}
+
+CLIBAPI void clib_term_begin(ClibTermBuf* tb){
+    clib__term_active = tb;
+    // What the terminal had before is unknown, so the first reset always goes out
+    tb->styled = true;
+    tb->last_sgr[0] = '\0';
+    if(tb->sync) clib_termbuf_write(tb, SYNC_UPDATE_BEGIN, sizeof(SYNC_UPDATE_BEGIN) - 1);
+}
+
+CLIBAPI void clib_term_end(){
+    ClibTermBuf* tb = clib__term_active;
+    if(tb == NULL) return;
+
+    if(tb->sync) clib_termbuf_write(tb, SYNC_UPDATE_END, sizeof(SYNC_UPDATE_END) - 1);
+    clib_termbuf_flush(tb);
+    clib__term_active = NULL;
+}
+
+CLIBAPI void clib_term_write(Cstr data, size_t length){
+    if(clib__term_active) clib_termbuf_write(clib__term_active, data, length);
+    else fwrite(data, 1, length, stdout);
+}
+
+CLIBAPI void clib_term_printf(Cstr format, ...){
+    va_list args;
+    va_start(args, format);
+    if(clib__term_active) clib__termbuf_vprintf(clib__term_active, format, args);
+    else vprintf(format, args);
+    va_end(args);
+}
+
+// Makes `tb` (or stdout, with NULL) the target of the ANSI macros without
+// sending anything, and returns the previous target
+CLIBAPI ClibTermBuf* clib_term_redirect(ClibTermBuf* tb){
+    ClibTermBuf* previous = clib__term_active;
+    clib__term_active = tb;
+    return previous;
+}
+
+CLIBAPI void clib_term_size(int* columns, int* rows){
+    *columns = 80;
+    *rows = 24;
+#ifndef _WIN32
+    struct winsize size;
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 0){
+        *columns = size.ws_col;
+        *rows = size.ws_row;
+    }
+#endif
+}
+
+CLIBAPI void clib_clear_screen() {
+#ifdef _WIN32
+    system("cls"); // Clear screen for Windows
+#else
+    system("clear"); // Clear screen for Linux and macOS
+#endif
+}
+
+
+CLIBAPI void clib_print_color_table(){
+    for(int i = 0; i < 256; i++){
+        if(i % 21 == 0) printf("\n");
+        
+        printf("%s%3d ", clib_color(i, 0), i);
+    }
+    printf("%s\n", RESET);
+}
+
+// Returns the index just past the escape sequence starting at i
+static size_t clib__escape_end(Cstr text, size_t length, size_t i){
+    if(i + 1 >= length) return length;
+    if(text[i + 1] != '[') return i + 2;
+
+    for(i += 2; i < length; ++i){
+        if(text[i] >= 0x40 && text[i] <= 0x7e) return i + 1;
+    }
+    return length;
+}
+
+CLIBAPI size_t clib_display_width(Cstr text, size_t length){
+    size_t width = 0;
+    for(size_t i = 0; i < length; ){
+        if(text[i] == '\e'){
+            i = clib__escape_end(text, length, i);
+            continue;
+        }
+        if((text[i] & 0xc0) != 0x80) width++;
+        i++;
+    }
+    return width;
+}
+
+// Padding is copied from here rather than built per cell
+static const char clib__spaces[64] = "                                                                ";
+
+static void clib__write_spaces(ClibTermBuf* out, size_t count){
+    while(count > 0){
+        size_t chunk = count < sizeof(clib__spaces) ? count : sizeof(clib__spaces);
+        clib_termbuf_write(out, clib__spaces, chunk);
+        count -= chunk;
+    }
+}
+
+CLIBAPI void clib_table_init(ClibTable* table, ClibTableColumn* columns, size_t column_count, ClibTableMode mode, int fd){
+    *table = (ClibTable) {
+        .columns = columns,
+        .column_count = column_count,
+        .mode = mode,
+        .tty = isatty(fd),
+    };
+    table->scratch = (Cstr*) clib_safe_malloc((column_count ? column_count : 1) * sizeof(Cstr));
+    clib_termbuf_init(&table->out, fd);
+}
+
+// Only output to a terminal goes through the SGR coalescing, so files and
+// pipes get the cells byte for byte
+static void clib__table_write(ClibTable* table, Cstr data, size_t length){
+    if(table->tty){
+        clib_termbuf_write(&table->out, data, length);
+        return;
+    }
+
+    ClibTermBuf* out = &table->out;
+    clib__termbuf_reserve(out, length);
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+CLIBAPI void clib_table_measure(ClibTable* table, Cstr* cells){
+    for(size_t i = 0; i < table->column_count; ++i){
+        ClibTableColumn* column = &table->columns[i];
+        size_t width = clib_display_width(cells[i], strlen(cells[i]));
+        if(column->max_width > 0 && width > column->max_width) width = column->max_width;
+        if(width > column->width) column->width = width;
+    }
+}
+
+static void clib__table_cell(ClibTable* table, const ClibTableColumn* column, Cstr cell, int last){
+    size_t length = strlen(cell);
+    size_t width = clib_display_width(cell, length);
+
+    // Keeps as many characters as fit next to an ellipsis
+    int styled = false;
+    if(table->truncate && width > column->width){
+        size_t visible = 0, i = 0;
+        while(i < length){
+            if(cell[i] == '\e'){
+                i = clib__escape_end(cell, length, i);
+                styled = true;
+                continue;
+            }
+            if((cell[i] & 0xc0) != 0x80 && visible++ == column->width - 1) break;
+            i++;
+        }
+        length = column->width > 0 ? i : 0;
+        width = column->width;
+    }
+
+    size_t padding = column->width > width ? column->width - width : 0;
+    if(column->align_right) clib__write_spaces(&table->out, padding);
+
+    clib__table_write(table, cell, length);
+    if(length < strlen(cell) && column->width > 0) clib__table_write(table, "…", sizeof("…") - 1);
+    if(styled) clib__table_write(table, RESET, sizeof(RESET) - 1);
+
+    if(!column->align_right && !last) clib__write_spaces(&table->out, padding);
+}
+
+static void clib__table_write_row(ClibTable* table, Cstr* cells){
+    Cstr separator = table->separator ? table->separator : "  ";
+    for(size_t i = 0; i < table->column_count; ++i){
+        if(i > 0) clib__table_write(table, separator, strlen(separator));
+        clib__table_cell(table, &table->columns[i], cells[i], i + 1 == table->column_count);
+    }
+    CLIB_TERMBUF_LITERAL(&table->out, "\n");
+
+    if(table->out.length >= CLIB_TABLE_FLUSH_SIZE) clib_termbuf_flush(&table->out);
+}
+
+// Writes the header, then the rows held back while sampling
+static void clib__table_start(ClibTable* table){
+    table->started = true;
+
+    Cstr* cells = table->scratch;
+    for(size_t i = 0; i < table->column_count; ++i){
+        cells[i] = table->columns[i].header ? table->columns[i].header : "";
+    }
+    if(table->mode != CLIB_TABLE_FIXED) clib_table_measure(table, cells);
+
+    if(table->tty) CLIB_TERMBUF_LITERAL(&table->out, BOLD);
+    clib__table_write_row(table, cells);
+    if(table->tty) CLIB_TERMBUF_LITERAL(&table->out, RESET);
+
+    char* cursor = table->held;
+    for(size_t row = 0; row < table->held_rows; ++row){
+        for(size_t i = 0; i < table->column_count; ++i){
+            cells[i] = cursor;
+            cursor += strlen(cursor) + 1;
+        }
+        clib__table_write_row(table, cells);
+    }
+
+    free(table->held);
+    table->held = NULL;
+    table->held_length = table->held_capacity = table->held_rows = 0;
+}
+
+CLIBAPI void clib_table_row(ClibTable* table, Cstr* cells){
+    if(!table->started && table->mode == CLIB_TABLE_SAMPLED){
+        clib_table_measure(table, cells);
+
+        for(size_t i = 0; i < table->column_count; ++i){
+            size_t size = strlen(cells[i]) + 1;
+            if(table->held_length + size > table->held_capacity){
+                table->held_capacity = table->held_capacity ? table->held_capacity * 2 : 4096;
+                if(table->held_capacity < table->held_length + size) table->held_capacity = table->held_length + size;
+                table->held = (char*) clib_safe_realloc(table->held, table->held_capacity);
+            }
+            memcpy(table->held + table->held_length, cells[i], size);
+            table->held_length += size;
+        }
+
+        size_t sample = table->sample ? table->sample : CLIB_TABLE_SAMPLE;
+        if(++table->held_rows >= sample) clib__table_start(table);
+        return;
+    }
+
+    if(!table->started) clib__table_start(table);
+    clib__table_write_row(table, cells);
+}
+
+// Writes whatever is left and frees the table
+CLIBAPI void clib_table_finish(ClibTable* table){
+    if(!table->started) clib__table_start(table);
+    clib_termbuf_flush(&table->out);
+    clib_termbuf_free(&table->out);
+    free(table->scratch);
+    table->scratch = NULL;
+}
+
+
+CLIBAPI void clib_copy_file(const char *source, const char *destination) {
+    CLIB_PROFILE_FUNCTION();
+    FILE *srcFile = fopen(source, "r");
+    if (srcFile == NULL) {
+        perror("Error opening source file");
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *destFile = fopen(destination, "w");
+    if (destFile == NULL) {
+        perror("Error opening destination file");
+        fclose(srcFile);
+        exit(EXIT_FAILURE);
+    }
+
+    char buffer[256];
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, 1, sizeof(buffer), srcFile)) > 0) {
+        if (fwrite(buffer, 1, bytesRead, destFile) != bytesRead) {
+            perror("Error writing to destination file");
+            fclose(srcFile);
+            fclose(destFile);
+            exit(EXIT_FAILURE);
+        }
+        CLIB_METRIC_ADD(CLIB_METRIC_FILE_READ_BYTES, bytesRead);
+        CLIB_METRIC_ADD(CLIB_METRIC_FILE_WRITTEN_BYTES, bytesRead);
+    }
+
+    fclose(srcFile);
+    fclose(destFile);
+}
+
+CLIBAPI void clib_move_file(const char *source, const char *destination) {
+    CLIB_PROFILE_FUNCTION();
+    if (rename(source, destination) != 0) {
+        perror("Error moving/renaming file");
+        exit(EXIT_FAILURE);
+    }
+}
+
+CLIBAPI long clib_file_size(const char *filename) {
+    CLIB_PROFILE_FUNCTION();
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        perror("Error opening file");
+        exit(EXIT_FAILURE);
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+CLIBAPI int clib_file_exists(const char *filename) {
+    CLIB_PROFILE_FUNCTION();
+    FILE *file = fopen(filename, "r");
+    if (file != NULL) {
+        fclose(file);
+        return 1;
+    }
+    return 0;
+}
+
+CLIBAPI void clib_append_file(const char *filename, const char *data) {
+    CLIB_PROFILE_FUNCTION();
+    FILE *file = fopen(filename, "a");
+    if (file == NULL) {
+        perror("Error opening file for appending");
+        exit(EXIT_FAILURE);
+    }
+    if (fputs(data, file) == EOF) {
+        perror("Error appending to file");
+        fclose(file);
+        exit(EXIT_FAILURE);
+    }
+    CLIB_METRIC_ADD(CLIB_METRIC_FILE_WRITTEN_BYTES, strlen(data));
+    fclose(file);
+}
+
+CLIBAPI void clib_create_file(const char *filename) {
+    CLIB_PROFILE_FUNCTION();
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        perror("Error creating file");
+        exit(EXIT_FAILURE);
+    }
+    fclose(file);
+}
+
+CLIBAPI void clib_write_file(const char *filename, const char *data, Cstr mode) {
+    CLIB_PROFILE_FUNCTION();
+    if(
+        strcmp(mode, "w") &&
+        strcmp(mode, "w+") &&
+        strcmp(mode, "a") &&
+        strcmp(mode, "a+")
+    ) {
+        PANIC("Writing file using invalid mode: %s", mode);
+    }
+
+    FILE *file = fopen(filename, mode);
+    if (file == NULL) {
+        perror("Error opening file for writing");
+        exit(EXIT_FAILURE);
+    }
+    if (fputs(data, file) == EOF) {
+        perror("Error writing to file");
+        fclose(file);
+        exit(EXIT_FAILURE);
+    }
+    CLIB_METRIC_ADD(CLIB_METRIC_FILE_WRITTEN_BYTES, strlen(data));
+    fclose(file);
+}
+
+CLIBAPI char* clib_read_file(const char *filename) {
+    CLIB_PROFILE_FUNCTION();
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        perror("Error opening file for reading");
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *buffer = (char*)malloc(file_size + 1);
+    if (buffer == NULL) {
+        perror("Error allocating memory");
+        fclose(file);
+        return NULL;
+    }
+
+    size_t bytesRead = fread(buffer, 1, file_size, file);
+    if (bytesRead != file_size) {
+        perror("Error reading file");
+        free(buffer);
+        fclose(file);
+        return NULL;
+    }
+
+    buffer[file_size] = '\0';
+    CLIB_METRIC_ADD(CLIB_METRIC_FILE_READ_BYTES, bytesRead);
+
+    fclose(file);
+    return buffer;
+}
+
+CLIBAPI void clib_delete_file(const char *filename) {
+    CLIB_PROFILE_FUNCTION();
+    if (remove(filename) != 0) {
+        perror("Error deleting file");
+        exit(EXIT_FAILURE);
+    }
+}
+
+CLIBAPI void* clib_safe_malloc(size_t size) {
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+CLIBAPI void* clib_safe_calloc(size_t nmemb, size_t size) {
+    void *ptr = calloc(nmemb, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Memory allocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+CLIBAPI void* clib_safe_realloc(void *ptr, size_t size) {
+    void *new_ptr = realloc(ptr, size);
+    if (new_ptr == NULL) {
+        fprintf(stderr, "Memory reallocation error\n");
+        exit(EXIT_FAILURE);
+    }
+    return new_ptr;
+}
+
+CLIBAPI void clib_safe_free(void **ptr) {
+    if (ptr != NULL && *ptr != NULL) {
+        free(*ptr);
+        *ptr = NULL;
+    }
+}
+
+#ifndef _WIN32
+CLIBAPI char* clib_execute_command(const char* command) {
+    CLIB_PROFILE_FUNCTION();
+    CLIB_METRIC_ADD(CLIB_METRIC_COMMANDS, 1);
+    CLIB_METRIC_TIME(CLIB_METRIC_COMMAND_SECONDS);
+    char buffer[128];
+    char *result = NULL;
+    size_t result_size = 0;
+    FILE *pipe = popen(command, "r");
+    if (!pipe) {
+        return NULL;
+    }
+
+    while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
+        size_t buffer_len = strlen(buffer);
+        result = realloc(result, result_size + buffer_len + 1);
+        if (!result) {
+            pclose(pipe);
+            return NULL;
+        }
+        strcpy(result + result_size, buffer);
+        result_size += buffer_len;
+    }
+
+    pclose(pipe);
+    return result;
+}
+
+CLIB_HASHMAP_IMPL(ClibEnvMap, clib__env_map, CstrView, Cstr, clib_hash_view, clib_view_equal)
+
+extern char** environ;
+
+// Only change with the lock held, which is also held while environ is
+// changed or copied. The generation counts the snapshots dropped, so
+// clib_get_env can keep using the one it holds without taking the lock.
+static ClibEnv* clib__env_current = NULL;
+static _Atomic size_t clib__env_generation = 0;
+static pthread_mutex_t clib__env_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// The snapshot clib_get_env reads on this thread, and its generation. The
+// key gives the reference back when the thread exits.
+static _Thread_local const ClibEnv* clib__env_held = NULL;
+static _Thread_local size_t clib__env_held_generation = 0;
+static pthread_key_t clib__env_held_key;
+static pthread_once_t clib__env_held_once = PTHREAD_ONCE_INIT;
+
+static void clib__env_held_exit(void* env){
+    clib_env_release((const ClibEnv*) env);
+}
+
+static void clib__env_held_key_create(){
+    pthread_key_create(&clib__env_held_key, clib__env_held_exit);
+}
+
+// Copies the "NAME=value" strings of a NULL-terminated array into a
+// snapshot with one reference. As with getenv, the first of two equal
+// names is the one found.
+CLIBAPI ClibEnv* clib_env_from(char* const* vars){
+    size_t count = 0, size = 0;
+    for(; vars[count] != NULL; ++count) size += strlen(vars[count]) + 1;
+
+    ClibEnv* env = (ClibEnv*) clib_safe_calloc(1, sizeof(ClibEnv));
+    env->refs = 1;
+    env->block = (char*) clib_safe_malloc(size ? size : 1);
+    env->envp = (char**) clib_safe_malloc((count + 1) * sizeof(char*));
+    clib__env_map_init(&env->map);
+
+    char* at = env->block;
+    for(size_t i = 0; i < count; ++i){
+        Cstr equals = strchr(vars[i], '=');
+        if(equals == NULL) continue;
+
+        size_t length = strlen(vars[i]) + 1;
+        memcpy(at, vars[i], length);
+
+        int existed;
+        ClibEnvMapEntry* entry = clib__env_map_emplace(&env->map, (CstrView) { at, equals - vars[i] }, &existed);
+        if(!existed) entry->value = at + (equals - vars[i]) + 1;
+
+        env->envp[env->count++] = at;
+        at += length;
+    }
+    env->envp[env->count] = NULL;
+    return env;
+}
+
+CLIBAPI const ClibEnv* clib_env_retain(const ClibEnv* env){
+    atomic_fetch_add_explicit(&((ClibEnv*) env)->refs, 1, memory_order_relaxed);
+    return env;
+}
+
+CLIBAPI void clib_env_release(const ClibEnv* env){
+    if(env == NULL) return;
+    ClibEnv* owned = (ClibEnv*) env;
+    if(atomic_fetch_sub_explicit(&owned->refs, 1, memory_order_acq_rel) != 1) return;
+
+    clib__env_map_free(&owned->map);
+    free(owned->block);
+    free(owned->envp);
+    free(owned);
+}
+
+// Returns a reference to the process snapshot, to give back with
+// clib_env_release. Held references stay valid across changes.
+static const ClibEnv* clib__env_take(size_t* generation){
+    pthread_mutex_lock(&clib__env_lock);
+    if(clib__env_current == NULL) clib__env_current = clib_env_from(environ);
+    const ClibEnv* env = clib_env_retain(clib__env_current);
+    *generation = atomic_load_explicit(&clib__env_generation, memory_order_relaxed);
+    pthread_mutex_unlock(&clib__env_lock);
+    return env;
+}
+
+CLIBAPI const ClibEnv* clib_env_current(){
+    size_t generation;
+    return clib__env_take(&generation);
+}
+
+// Detaches the process snapshot, so the next clib_env_current copies
+// environ again. Must be called with the lock held; the caller releases
+// the returned snapshot after giving the lock back.
+static ClibEnv* clib__env_detach(){
+    ClibEnv* old = clib__env_current;
+    clib__env_current = NULL;
+    atomic_fetch_add_explicit(&clib__env_generation, 1, memory_order_release);
+    return old;
+}
+
+CLIBAPI void clib_env_refresh(){
+    pthread_mutex_lock(&clib__env_lock);
+    ClibEnv* old = clib__env_detach();
+    pthread_mutex_unlock(&clib__env_lock);
+    clib_env_release(old);
+}
+
+// The value of name, or NULL when it is not set
+CLIBAPI Cstr clib_env_get(const ClibEnv* env, Cstr name){
+    Cstr* value = clib__env_map_get(&env->map, CLIB_VIEW(name));
+    return value ? *value : NULL;
+}
+
+// Holds a reference to base, which can be NULL for an empty environment
+CLIBAPI void clib_env_overlay_init(ClibEnvOverlay* overlay, const ClibEnv* base){
+    *overlay = (ClibEnvOverlay) { .base = base ? clib_env_retain(base) : NULL };
+    clib__env_map_init(&overlay->changes);
+}
+
+CLIBAPI void clib_env_overlay_free(ClibEnvOverlay* overlay){
+    ClibEnvMap* changes = &overlay->changes;
+    for(size_t i = clib__env_map_next(changes, 0); i < changes->capacity; i = clib__env_map_next(changes, i + 1)){
+        free((char*) changes->entries[i].key.data);
+    }
+    clib__env_map_free(changes);
+    clib_env_release(overlay->base);
+    *overlay = (ClibEnvOverlay) {0};
+}
+
+static void clib__env_overlay_put(ClibEnvOverlay* overlay, Cstr name, Cstr value){
+    size_t name_length = strlen(name);
+    size_t value_length = value ? strlen(value) : 0;
+
+    char* text = (char*) clib_safe_malloc(name_length + 1 + value_length + 1);
+    memcpy(text, name, name_length);
+    text[name_length] = '=';
+    if(value) memcpy(text + name_length + 1, value, value_length);
+    text[name_length + 1 + value_length] = '\0';
+
+    // The key has to point at the copy, and the old copy goes
+    int existed;
+    ClibEnvMapEntry* entry = clib__env_map_emplace(&overlay->changes, (CstrView) { name, name_length }, &existed);
+    if(existed) free((char*) entry->key.data);
+    entry->key = (CstrView) { text, name_length };
+    entry->value = value ? text + name_length + 1 : NULL;
+}
+
+CLIBAPI void clib_env_overlay_set(ClibEnvOverlay* overlay, Cstr name, Cstr value){
+    clib__env_overlay_put(overlay, name, value);
+}
+
+CLIBAPI void clib_env_overlay_unset(ClibEnvOverlay* overlay, Cstr name){
+    clib__env_overlay_put(overlay, name, NULL);
+}
+
+CLIBAPI Cstr clib_env_overlay_get(const ClibEnvOverlay* overlay, Cstr name){
+    ClibEnvMapEntry* change = clib__env_map_find(&overlay->changes, CLIB_VIEW(name));
+    if(change != NULL) return change->value;
+    return overlay->base ? clib_env_get(overlay->base, name) : NULL;
+}
+
+// Makes a snapshot of the base with the changes applied, with one reference
+CLIBAPI ClibEnv* clib_env_overlay_freeze(const ClibEnvOverlay* overlay){
+    const ClibEnv* base = overlay->base;
+    const ClibEnvMap* changes = &overlay->changes;
+    size_t base_count = base ? base->count : 0;
+    char** vars = (char**) clib_safe_malloc((base_count + changes->count + 1) * sizeof(char*));
+    size_t count = 0;
+
+    for(size_t i = 0; i < base_count; ++i){
+        Cstr var = base->envp[i];
+        CstrView name = { var, (size_t) (strchr(var, '=') - var) };
+        if(clib__env_map_find(changes, name) == NULL) vars[count++] = (char*) var;
+    }
+    for(size_t i = clib__env_map_next(changes, 0); i < changes->capacity; i = clib__env_map_next(changes, i + 1)){
+        if(changes->entries[i].value != NULL) vars[count++] = (char*) changes->entries[i].key.data;
+    }
+    vars[count] = NULL;
+
+    ClibEnv* env = clib_env_from(vars);
+    free(vars);
+    return env;
+}
+
+// Reads the process snapshot, which the thread keeps a reference to until
+// a later call finds it was dropped. The value stays valid until then.
+CLIBAPI char* clib_get_env(const char* varname) {
+    size_t generation = atomic_load_explicit(&clib__env_generation, memory_order_acquire);
+    if(clib__env_held == NULL || clib__env_held_generation != generation){
+        const ClibEnv* old = clib__env_held;
+        clib__env_held = clib__env_take(&clib__env_held_generation);
+        pthread_once(&clib__env_held_once, clib__env_held_key_create);
+        pthread_setspecific(clib__env_held_key, clib__env_held);
+        clib_env_release(old);
+    }
+    return (char*) clib_env_get(clib__env_held, varname);
+}
+
+CLIBAPI int clib_set_env(const char* varname, const char* value, int overwrite) {
+    pthread_mutex_lock(&clib__env_lock);
+    int result = setenv(varname, value, overwrite);
+    ClibEnv* old = clib__env_detach();
+    pthread_mutex_unlock(&clib__env_lock);
+    clib_env_release(old);
+    return result;
+}
+
+CLIBAPI int clib_unset_env(const char* varname) {
+    pthread_mutex_lock(&clib__env_lock);
+    int result = unsetenv(varname);
+    ClibEnv* old = clib__env_detach();
+    pthread_mutex_unlock(&clib__env_lock);
+    clib_env_release(old);
+    return result;
+}
+#endif
+
+#ifdef CLIB_CONFIG
+CLIBAPI void clib_config_init(ClibConfig* config, const ClibConfigVar* vars, size_t count){
+    *config = (ClibConfig) { .vars = vars, .count = count };
+    config->values = (Cstr*) clib_safe_calloc(count ? count : 1, sizeof(Cstr));
+    config->sources = (ClibConfigSource*) clib_safe_calloc(count ? count : 1, sizeof(ClibConfigSource));
+    config->key_ids = (uint32_t*) clib_safe_calloc(count ? count : 1, sizeof(uint32_t));
+
+    clib_interner_init(&config->keys);
+    for(size_t i = 0; i < count; ++i){
+        if(vars[i].key) config->key_ids[i] = clib_intern(&config->keys, CLIB_VIEW(vars[i].key));
+    }
+}
+
+CLIBAPI void clib_config_clean(ClibConfig* config){
+    for(size_t i = 0; i < config->file_count; ++i){
+        ClibConfigFile* file = &config->files[i];
+        if(file->mapped) munmap(file->data, file->size + 1);
+        else free(file->data);
+    }
+    free(config->files);
+
+    free(config->values);
+    free(config->sources);
+    free(config->key_ids);
+    clib_interner_free(&config->keys);
+    clib_env_release(config->env);
+    *config = (ClibConfig) {0};
+}
+
+CLIBAPI void clib_config_set(ClibConfig* config, size_t index, Cstr value, ClibConfigSource source){
+    assert(index < config->count);
+    if(value == NULL || source < config->sources[index]) return;
+
+    config->values[index] = value;
+    config->sources[index] = source;
+}
+
+static int clib__config_is_space(char c){
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// The ID of `section.key` (or just `key` outside of any section), which is
+// CLIB_INTERN_NONE unless one of the variables uses it
+static uint32_t clib__config_key_id(const ClibConfig* config, Cstr section, size_t section_length, Cstr key, size_t key_length){
+    if(section_length == 0) return clib_intern_find(&config->keys, (CstrView) { key, key_length });
+
+    // Lines come from the file, so a long one goes to the heap
+    char buffer[256];
+    size_t length = section_length + 1 + key_length;
+    char* full_key = length <= sizeof(buffer) ? buffer : (char*) clib_safe_malloc(length);
+
+    memcpy(full_key, section, section_length);
+    full_key[section_length] = '.';
+    memcpy(full_key + section_length + 1, key, key_length);
+    uint32_t id = clib_intern_find(&config->keys, (CstrView) { full_key, length });
+
+    if(full_key != buffer) free(full_key);
+    return id;
+}
+
+// Unquotes a TOML basic ("...") or literal ('...') string in place
+static char* clib__config_unquote(char* value, char* end){
+    char quote = *value;
+    char* read = value + 1;
+    char* write = value;
+
+    while(read < end && *read != quote){
+        if(quote == '"' && *read == '\\' && read + 1 < end){
+            read++;
+            switch(*read){
+                case 'n': *write++ = '\n'; break;
+                case 't': *write++ = '\t'; break;
+                case 'r': *write++ = '\r'; break;
+                default: *write++ = *read; break;
+            }
+            read++;
+            continue;
+        }
+        *write++ = *read++;
+    }
+    *write = '\0';
+    return value;
+}
+
+// Parses an INI/TOML subset in place: `[section]` headers, `key = value`
+// pairs, quoted strings and `#`/`;` comments. Values point into the buffer.
+static void clib__config_parse(ClibConfig* config, char* data, size_t size){
+    char* end = data + size;
+    Cstr section = NULL;
+    size_t section_length = 0;
+
+    for(char* line = data; line < end; ){
+        char* eol = (char*) memchr(line, '\n', end - line);
+        if(eol == NULL) eol = end;
+        char* next = eol + 1;
+
+        while(line < eol && clib__config_is_space(*line)) line++;
+        char* last = eol;
+        while(last > line && clib__config_is_space(last[-1])) last--;
+
+        if(line == last || *line == '#' || *line == ';'){
+            line = next;
+            continue;
+        }
+
+        if(*line == '['){
+            char* close = (char*) memchr(line, ']', last - line);
+            if(close){
+                section = line + 1;
+                section_length = close - section;
+            }
+            line = next;
+            continue;
+        }
+
+        char* equals = (char*) memchr(line, '=', last - line);
+        if(equals == NULL){
+            line = next;
+            continue;
+        }
+
+        char* key_end = equals;
+        while(key_end > line && clib__config_is_space(key_end[-1])) key_end--;
+        char* value = equals + 1;
+        while(value < last && clib__config_is_space(*value)) value++;
+
+        if(*value == '"' || *value == '\''){
+            value = clib__config_unquote(value, last);
+        } else {
+            for(char* c = value; c < last; ++c){
+                if((*c == '#' || *c == ';') && (c == value || clib__config_is_space(c[-1]))){
+                    last = c;
+                    break;
+                }
+            }
+            while(last > value && clib__config_is_space(last[-1])) last--;
+            *last = '\0';
+        }
+
+        uint32_t id = clib__config_key_id(config, section, section_length, line, key_end - line);
+        for(size_t i = 0; id != CLIB_INTERN_NONE && i < config->count; ++i){
+            if(config->key_ids[i] == id) clib_config_set(config, i, value, CLIB_CONFIG_FILE);
+        }
+
+        line = next;
+    }
+}
+
+// The file is mapped copy-on-write and parsed in place, so the values are
+// never copied. Missing files are not an error. Any number of files can be
+// loaded, and a later one wins over an earlier one.
+CLIBAPI int clib_config_load_file(ClibConfig* config, Cstr path){
+    CLIB_PROFILE_FUNCTION();
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return errno == ENOENT ? 0 : -1;
+
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        close(fd);
+        return -1;
+    }
+
+    size_t size = (size_t) st.st_size;
+    long page = sysconf(_SC_PAGESIZE);
+    char* data = NULL;
+    int mapped = false;
+
+    // The byte after the data is used as a terminator, which a mapping
+    // only has when the file does not end on a page boundary
+    if(size > 0 && size % page != 0){
+        data = (char*) mmap(NULL, size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED) data = NULL;
+        else mapped = true;
+    }
+
+    if(data == NULL){
+        data = (char*) clib_safe_malloc(size + 1);
+        size_t total = 0;
+        while(total < size){
+            ssize_t n = read(fd, data + total, size - total);
+            if(n <= 0) break;
+            total += n;
+        }
+        size = total;
+    }
+    close(fd);
+
+    data[size] = '\0';
+    config->files = (ClibConfigFile*) clib_safe_realloc(config->files, (config->file_count + 1) * sizeof(ClibConfigFile));
+    config->files[config->file_count++] = (ClibConfigFile) { data, size, mapped };
+
+    clib__config_parse(config, data, size);
+    return 0;
+}
+
+// Parses the bound options with clib_opt_parse. Returns the new argc, or -1.
+CLIBAPI int clib_config_parse_args(ClibConfig* config, int argc, char** argv){
+    ClibOption options[CLIB_OPT_MAX];
+    Cstr values[CLIB_OPT_MAX] = {0};
+    size_t count = 0;
+    size_t indices[CLIB_OPT_MAX];
+
+    for(size_t i = 0; i < config->count && count < CLIB_OPT_MAX; ++i){
+        const ClibConfigVar* var = &config->vars[i];
+        if(var->abr == 0 && var->full == NULL) continue;
+
+        options[count] = (ClibOption) {
+            var->abr, var->full, var->help, CLIB_OPT_STRING, required_argument, count * sizeof(Cstr)
+        };
+        indices[count++] = i;
+    }
+
+    ClibOptParser parser;
+    if(clib_opt_parser_init(&parser, options, count) != 0) return -1;
+
+    argc = clib_opt_parse(&parser, argc, argv, values);
+    if(argc < 0) return -1;
+
+    for(size_t i = 0; i < count; ++i){
+        clib_config_set(config, indices[i], values[i], CLIB_CONFIG_CLI);
+    }
+    return argc;
+}
+
+// Fills in the environment and the defaults. A source never replaces a
+// value from a higher one, so the layers can be loaded in any order.
+CLIBAPI void clib_config_resolve(ClibConfig* config){
+    if(config->env == NULL) config->env = clib_env_current();
+    for(size_t i = 0; i < config->count; ++i){
+        const ClibConfigVar* var = &config->vars[i];
+        if(var->env) clib_config_set(config, i, clib_env_get(config->env, var->env), CLIB_CONFIG_ENV);
+        clib_config_set(config, i, var->fallback, CLIB_CONFIG_DEFAULT);
+    }
+}
+
+CLIBAPI void clib_config_help(const ClibConfig* config, Cstr usage, Cstr footer){
+    ClibOption options[CLIB_OPT_MAX];
+    size_t count = 0;
+
+    for(size_t i = 0; i < config->count && count < CLIB_OPT_MAX; ++i){
+        const ClibConfigVar* var = &config->vars[i];
+        if(var->abr == 0 && var->full == NULL) continue;
+        options[count++] = (ClibOption) { var->abr, var->full, var->help, CLIB_OPT_STRING, required_argument, 0 };
+    }
+
+    clib_opt_help(options, count, usage, footer);
+}
+#endif // CLIB_CONFIG
+
+#ifdef CLIB_PROFILE
+static _Atomic(ClibProfileThread*) clib__profile_threads = NULL;
+static CLIB_THREAD_LOCAL ClibProfileThread* clib__profile_thread = NULL;
+static uint64_t clib__profile_start_ns = 0;
+static Cstr clib__profile_path = NULL;
+
+CLIBAPI uint64_t clib_profile_now_ns(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static ClibProfileThread* clib__profile_get_thread(){
+    if(LIKELY(clib__profile_thread != NULL)) return clib__profile_thread;
+
+    ClibProfileThread* thread = (ClibProfileThread*) clib_safe_calloc(1,
+        sizeof(ClibProfileThread) + sizeof(ClibProfileEvent) * CLIB_PROFILE_CAPACITY);
+    thread->tid = clib_thread_id();
+
+    // Buffers are never freed, so the exporter can still read the ones of
+    // threads that already exited
+    ClibProfileThread* head = atomic_load_explicit(&clib__profile_threads, memory_order_relaxed);
+    do {
+        thread->next = head;
+    } while(!atomic_compare_exchange_weak_explicit(&clib__profile_threads, &head, thread,
+        memory_order_release, memory_order_relaxed));
+
+    clib__profile_thread = thread;
+    return thread;
+}
+
+static void clib__profile_record(ClibProfileEvent event){
+    ClibProfileThread* thread = clib__profile_get_thread();
+    size_t index = atomic_load_explicit(&thread->count, memory_order_relaxed);
+
+    if(UNLIKELY(index >= CLIB_PROFILE_CAPACITY)){
+        atomic_store_explicit(&thread->dropped,
+            atomic_load_explicit(&thread->dropped, memory_order_relaxed) + 1, memory_order_relaxed);
+        return;
+    }
+
+    thread->events[index] = event;
+    atomic_store_explicit(&thread->count, index + 1, memory_order_release);
+}
+
+CLIBAPI ClibProfileZone clib_profile_zone_begin(Cstr name){
+    return (ClibProfileZone) { .name = name, .begin_ns = clib_profile_now_ns() };
+}
+
+CLIBAPI void clib_profile_zone_end(ClibProfileZone* zone){
+    uint64_t end = clib_profile_now_ns();
+    clib__profile_record((ClibProfileEvent) {
+        .name = zone->name,
+        .timestamp_ns = zone->begin_ns,
+        .duration_ns = end - zone->begin_ns,
+        .kind = CLIB_PROFILE_EVENT_ZONE,
+    });
+}
+
+CLIBAPI void clib_profile_counter(Cstr name, double value){
+    clib__profile_record((ClibProfileEvent) {
+        .name = name,
+        .timestamp_ns = clib_profile_now_ns(),
+        .value = value,
+        .kind = CLIB_PROFILE_EVENT_COUNTER,
+    });
+}
+
+static void clib__profile_write_name(FILE* file, Cstr name){
+    fputc('"', file);
+    for(Cstr c = name; *c; ++c){
+        if(*c == '"' || *c == '\\') fputc('\\', file);
+        if((unsigned char) *c >= 0x20) fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Writes every recorded event in the Chrome trace event format, which
+// chrome://tracing and ui.perfetto.dev both open
+CLIBAPI int clib_profile_export(Cstr path){
+    FILE* file = fopen(path, "w");
+    if(file == NULL){
+        perror("Error opening profile output");
+        return -1;
+    }
+
+    int pid = (int) getpid();
+    int first = true;
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+
+    ClibProfileThread* thread = atomic_load_explicit(&clib__profile_threads, memory_order_acquire);
+    for(; thread != NULL; thread = thread->next){
+        size_t count = atomic_load_explicit(&thread->count, memory_order_acquire);
+
+        for(size_t i = 0; i < count; ++i){
+            ClibProfileEvent* event = &thread->events[i];
+            double ts = (double) (event->timestamp_ns - clib__profile_start_ns) / 1000.0;
+
+            fprintf(file, "%s  {\"name\": ", first ? "" : ",\n");
+            clib__profile_write_name(file, event->name);
+            if(event->kind == CLIB_PROFILE_EVENT_ZONE){
+                fprintf(file, ", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %llu}",
+                    ts, (double) event->duration_ns / 1000.0, pid, (unsigned long long) thread->tid);
+            } else {
+                fprintf(file, ", \"ph\": \"C\", \"ts\": %.3f, \"pid\": %d, \"tid\": %llu, \"args\": {\"value\": %g}}",
+                    ts, pid, (unsigned long long) thread->tid, event->value);
+            }
+            first = false;
+        }
+
+        size_t dropped = atomic_load_explicit(&thread->dropped, memory_order_relaxed);
+        if(dropped){
+            fprintf(stderr, "[WARN] profile buffer of thread %llu was full, %zu events dropped\n",
+                (unsigned long long) thread->tid, dropped);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return 0;
+}
+
+static void clib__profile_atexit(){
+    if(clib__profile_path) clib_profile_export(clib__profile_path);
+}
+
+// Timestamps are relative to this call. With a path, the trace is written
+// there when the program exits.
+CLIBAPI void clib_profile_init(Cstr path){
+    clib__profile_start_ns = clib_profile_now_ns();
+    clib__profile_get_thread();
+
+    if(path != NULL && clib__profile_path == NULL) atexit(clib__profile_atexit);
+    clib__profile_path = path;
+}
+#endif // CLIB_PROFILE
+
+#ifdef CLIB_BENCH
+CLIBAPI uint64_t clib_bench_now_ns(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+CLIBAPI uint64_t clib_bench_cycles(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+CLIBAPI ClibBench clib_bench_make(ClibBenchConfig config){
+    ClibBench bench = { .config = config };
+    if(bench.config.warmup_ms == 0) bench.config.warmup_ms = 100;
+    if(bench.config.sample_ms == 0) bench.config.sample_ms = 10;
+    if(bench.config.samples == 0) bench.config.samples = 30;
+
+    return bench;
+}
+
+CLIBAPI void clib_bench_clean(ClibBench* bench){
+    free(bench->results);
+    bench->results = NULL;
+    bench->count = 0;
+    bench->capacity = 0;
+}
+
+// Newton's method, so the harness does not need libm
+static double clib__bench_sqrt(double value){
+    if(value <= 0) return 0;
+
+    double root = value > 1 ? value : 1;
+    for(int i = 0; i < 64; ++i){
+        double next = 0.5 * (root + value / root);
+        if(next >= root) break;
+        root = next;
+    }
+    return root;
+}
+
+static int clib__bench_compare(const void* a, const void* b){
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+CLIBAPI ClibBenchResult clib_bench_run(ClibBench* bench, Cstr name, size_t size, ClibBenchFunc func, void* ctx){
+    ClibBenchConfig config = bench->config;
+    uint64_t sample_ns = config.sample_ms * 1000000ull;
+
+    // Warmup
+    uint64_t start = clib_bench_now_ns();
+    while(clib_bench_now_ns() - start < config.warmup_ms * 1000000ull){
+        func(ctx, 1);
+    }
+
+    // Grow the iteration count until one sample takes about `sample_ms`
+    uint64_t iterations = 1;
+    for(;;){
+        start = clib_bench_now_ns();
+        func(ctx, iterations);
+        uint64_t elapsed = clib_bench_now_ns() - start;
+
+        if(elapsed >= sample_ns) break;
+
+        uint64_t factor = elapsed == 0 ? 10 : (sample_ns + elapsed - 1) / elapsed;
+        if(factor < 2) factor = 2;
+        if(factor > 10) factor = 10;
+        iterations *= factor;
+    }
+
+    double* ns = (double*) clib_safe_malloc(sizeof(double) * config.samples);
+    double* cycles = (double*) clib_safe_malloc(sizeof(double) * config.samples);
+    for(size_t i = 0; i < config.samples; ++i){
+        uint64_t c0 = clib_bench_cycles();
+        uint64_t t0 = clib_bench_now_ns();
+        func(ctx, iterations);
+        uint64_t t1 = clib_bench_now_ns();
+        uint64_t c1 = clib_bench_cycles();
+
+        ns[i] = (double) (t1 - t0) / iterations;
+        cycles[i] = (double) (c1 - c0) / iterations;
+    }
+
+    qsort(ns, config.samples, sizeof(double), clib__bench_compare);
+    qsort(cycles, config.samples, sizeof(double), clib__bench_compare);
+
+    ClibBenchResult result = {
+        .name = name,
+        .size = size,
+        .iterations = iterations,
+        .samples = config.samples,
+        .min_ns = ns[0],
+        .max_ns = ns[config.samples - 1],
+    };
+
+    size_t middle = config.samples / 2;
+    result.median_ns = config.samples % 2 ? ns[middle] : (ns[middle - 1] + ns[middle]) / 2;
+    result.median_cycles = cycles[middle];
+
+    size_t p99 = (config.samples * 99 + 99) / 100;
+    result.p99_ns = ns[p99 - 1];
+
+    double sum = 0;
+    for(size_t i = 0; i < config.samples; ++i) sum += ns[i];
+    result.mean_ns = sum / config.samples;
+
+    double variance = 0;
+    for(size_t i = 0; i < config.samples; ++i){
+        variance += (ns[i] - result.mean_ns) * (ns[i] - result.mean_ns);
+    }
+    if(config.samples > 1) variance /= config.samples - 1;
+    result.stddev_ns = clib__bench_sqrt(variance);
+
+    free(ns);
+    free(cycles);
+
+    if(bench->count == bench->capacity){
+        bench->capacity = bench->capacity ? bench->capacity * 2 : 16;
+        bench->results = (ClibBenchResult*) clib_safe_realloc(bench->results, sizeof(ClibBenchResult) * bench->capacity);
+    }
+    bench->results[bench->count++] = result;
+
+    return result;
+}
+
+CLIBAPI void clib_bench_report(ClibBench bench, ClibBenchFormat format, FILE* stream){
+    switch(format){
+    case CLIB_BENCH_TEXT:
+        fprintf(stream, "%-32s %10s %12s %12s %12s %12s %12s\n",
+            "name", "size", "iterations", "median(ns)", "p99(ns)", "stddev(ns)", "cycles");
+        for(size_t i = 0; i < bench.count; ++i){
+            ClibBenchResult r = bench.results[i];
+            fprintf(stream, "%-32s %10zu %12llu %12.1f %12.1f %12.1f %12.0f\n",
+                r.name, r.size, (unsigned long long) r.iterations,
+                r.median_ns, r.p99_ns, r.stddev_ns, r.median_cycles);
+        }
+        break;
+    case CLIB_BENCH_CSV:
+        fprintf(stream, "name,size,iterations,samples,min_ns,median_ns,mean_ns,p99_ns,max_ns,stddev_ns,median_cycles\n");
+        for(size_t i = 0; i < bench.count; ++i){
+            ClibBenchResult r = bench.results[i];
+            fprintf(stream, "%s,%zu,%llu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f\n",
+                r.name, r.size, (unsigned long long) r.iterations, r.samples,
+                r.min_ns, r.median_ns, r.mean_ns, r.p99_ns, r.max_ns, r.stddev_ns, r.median_cycles);
+        }
+        break;
+    case CLIB_BENCH_JSON:
+        fprintf(stream, "[\n");
+        for(size_t i = 0; i < bench.count; ++i){
+            ClibBenchResult r = bench.results[i];
+            fprintf(stream,
+                "  {\"name\": \"%s\", \"size\": %zu, \"iterations\": %llu, \"samples\": %zu, "
+                "\"min_ns\": %.3f, \"median_ns\": %.3f, \"mean_ns\": %.3f, \"p99_ns\": %.3f, "
+                "\"max_ns\": %.3f, \"stddev_ns\": %.3f, \"median_cycles\": %.1f}%s\n",
+                r.name, r.size, (unsigned long long) r.iterations, r.samples,
+                r.min_ns, r.median_ns, r.mean_ns, r.p99_ns, r.max_ns, r.stddev_ns, r.median_cycles,
+                i + 1 < bench.count ? "," : "");
+        }
+        fprintf(stream, "]\n");
+        break;
+    default:
+        assert(0 && "unreachable");
+    }
+}
+
+CLIBAPI ClibBenchFormat clib_bench_format_from_args(int argc, char** argv){
+    for(int i = 1; i < argc; ++i){
+        if(strcmp(argv[i], "--csv") == 0) return CLIB_BENCH_CSV;
+        if(strcmp(argv[i], "--json") == 0) return CLIB_BENCH_JSON;
+    }
+    return CLIB_BENCH_TEXT;
+}
+#endif // CLIB_BENCH
+
+#ifdef CLIB_PROGRESS
+static uint64_t clib__progress_now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Draws nothing unless stdout is a terminal.
+// hz is how often the renderer thread redraws, 0 for CLIB_PROGRESS_HZ.
+CLIBAPI void clib_progress_init(ClibProgress* progress, int hz){
+    memset(progress, 0, sizeof(*progress));
+    progress->hz = hz > 0 ? hz : CLIB_PROGRESS_HZ;
+    progress->enabled = isatty(STDOUT_FILENO);
+    clib_termbuf_init(&progress->out, STDOUT_FILENO);
+}
+
+// Returns NULL when every bar is in use. Bars are not thread-safe to add,
+// but can be added while the renderer runs.
+CLIBAPI ClibProgressBar* clib_progress_add_bar(ClibProgress* progress, Cstr label, uint64_t total){
+    size_t index = atomic_load(&progress->count);
+    if(index == CLIB_PROGRESS_MAX_BARS){
+        ERRO("Too many progress bars, the maximum is %d", CLIB_PROGRESS_MAX_BARS);
+        return NULL;
+    }
+
+    ClibProgressBar* bar = &progress->bars[index];
+    atomic_store(&bar->done, 0);
+    atomic_store(&bar->total, total);
+    snprintf(bar->label, sizeof(bar->label), "%s", label);
+    bar->last_ns = clib__progress_now_ns();
+    bar->last_done = 0;
+    bar->rate = 0;
+
+    atomic_store_explicit(&progress->count, index + 1, memory_order_release);
+    return bar;
+}
+
+// Writes count with a k/M/G suffix
+static void clib__progress_human(char* buffer, size_t size, double count){
+    static Cstr suffixes[] = { "", "k", "M", "G", "T" };
+    size_t i = 0;
+    while(count >= 1000 && i < 4){
+        count /= 1000;
+        i++;
+    }
+    if(i == 0) snprintf(buffer, size, "%.0f", count);
+    else snprintf(buffer, size, "%.1f%s", count, suffixes[i]);
+}
+
+static void clib__progress_render_bar(ClibProgress* progress, ClibProgressBar* bar, uint64_t now, int label_width, int bar_width){
+    uint64_t done = atomic_load_explicit(&bar->done, memory_order_relaxed);
+    uint64_t total = atomic_load_explicit(&bar->total, memory_order_relaxed);
+
+    // Rate over the last frame, smoothed so it does not flicker. It stops
+    // changing once the bar is full.
+    if(now > bar->last_ns && (total == 0 || bar->last_done < total)){
+        double rate = (done - bar->last_done) / ((now - bar->last_ns) / 1e9);
+        bar->rate = bar->last_done == 0 ? rate : 0.3 * rate + 0.7 * bar->rate;
+        bar->last_done = done;
+        bar->last_ns = now;
+    }
+
+    char count[32], rate[32];
+    clib__progress_human(count, sizeof(count), done);
+    clib__progress_human(rate, sizeof(rate), bar->rate);
+    clib_termbuf_printf(&progress->out, "\r%-*s ", label_width, bar->label);
+
+    if(total == 0){
+        clib_termbuf_printf(&progress->out, "%7s  %7s/s\e[K\n", count, rate);
+        return;
+    }
+
+    double fraction = done >= total ? 1.0 : (double) done / total;
+    int filled = fraction * bar_width;
+    CLIB_TERMBUF_LITERAL(&progress->out, "[");
+    for(int i = 0; i < bar_width; ++i) clib_termbuf_write(&progress->out, i < filled ? "#" : "-", 1);
+
+    char goal[32], eta[32] = "";
+    clib__progress_human(goal, sizeof(goal), total);
+    if(bar->rate > 0 && done < total){
+        unsigned long long seconds = (total - done) / bar->rate;
+        snprintf(eta, sizeof(eta), "  ETA %llu:%02llu", seconds / 60, seconds % 60);
+    }
+    clib_termbuf_printf(&progress->out, "] %5.1f%%  %7s/%-7s %7s/s%s\e[K\n", fraction * 100, count, goal, rate, eta);
+}
+
+// Redraws every bar with a single write. The renderer thread calls this,
+// or it can be driven from a timer instead of clib_progress_start.
+CLIBAPI void clib_progress_render(ClibProgress* progress){
+    if(!progress->enabled) return;
+
+    size_t count = atomic_load_explicit(&progress->count, memory_order_acquire);
+    int columns, rows;
+    clib_term_size(&columns, &rows);
+    uint64_t now = clib__progress_now_ns();
+
+    ClibTermBuf* out = &progress->out;
+    if(out->sync) CLIB_TERMBUF_LITERAL(out, SYNC_UPDATE_BEGIN);
+    if(progress->drawn > 0) clib_termbuf_printf(out, "\e[%zuA", progress->drawn);
+
+    // Labels and bars line up, and the bar takes what the text leaves over
+    int label_width = 0;
+    for(size_t i = 0; i < count; ++i){
+        int length = strlen(progress->bars[i].label);
+        if(length > label_width) label_width = length;
+    }
+    int bar_width = columns - label_width - 50;
+    if(bar_width > 40) bar_width = 40;
+    if(bar_width < 0) bar_width = 0;
+
+    for(size_t i = 0; i < count; ++i){
+        clib__progress_render_bar(progress, &progress->bars[i], now, label_width, bar_width);
+    }
+    progress->drawn = count;
+
+    if(out->sync) CLIB_TERMBUF_LITERAL(out, SYNC_UPDATE_END);
+    clib_termbuf_flush(out);
+}
+
+static void* clib__progress_thread(void* arg){
+    ClibProgress* progress = (ClibProgress*) arg;
+    struct timespec frame = { .tv_sec = 0, .tv_nsec = 1000000000l / progress->hz };
+    if(progress->hz == 1) frame = (struct timespec) { .tv_sec = 1, .tv_nsec = 0 };
+
+    while(atomic_load(&progress->running)){
+        clib_progress_render(progress);
+        nanosleep(&frame, NULL);
+    }
+    return NULL;
+}
+
+// Starts the renderer thread. Does nothing when stdout is not a terminal.
+CLIBAPI int clib_progress_start(ClibProgress* progress){
+    if(!progress->enabled || atomic_load(&progress->running)) return 0;
+
+    atomic_store(&progress->running, true);
+    int error = pthread_create(&progress->thread, NULL, clib__progress_thread, progress);
+    if(error != 0){
+        atomic_store(&progress->running, false);
+        ERRO("Could not start the progress renderer: %s", strerror(error));
+        return -1;
+    }
+    return 0;
+}
+
+// Stops the renderer and draws the final frame
+CLIBAPI void clib_progress_stop(ClibProgress* progress){
+    if(atomic_exchange(&progress->running, false)){
+        pthread_join(progress->thread, NULL);
+    }
+    clib_progress_render(progress);
+    clib_termbuf_free(&progress->out);
+}
+#endif // CLIB_PROGRESS
+
+#ifdef CLIB_WATCHER
+#define CLIB__WATCH_MASK (IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR)
+
+CLIB_HASHMAP_IMPL(ClibWatchMap, clib__watch_map, uint64_t, ClibWatch, clib_hash_u64, clib_u64_equal)
+CLIB_HASHMAP_IMPL(ClibWatchChanges, clib__watch_changes, CstrView, int, clib_hash_view, clib_view_equal)
+
+static int64_t clib__watcher_now_ms(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static char* clib__watcher_copy(Cstr text){
+    size_t size = strlen(text) + 1;
+    char* copy = (char*) clib_safe_malloc(size);
+    memcpy(copy, text, size);
+    return copy;
+}
+
+// debounce_ms below zero picks CLIB_WATCHER_DEBOUNCE_MS
+CLIBAPI int clib_watcher_init(ClibWatcher* watcher, int debounce_ms, ClibWatcherFunc func, void* ctx){
+    *watcher = (ClibWatcher) {
+        .debounce_ms = debounce_ms < 0 ? CLIB_WATCHER_DEBOUNCE_MS : debounce_ms,
+        .func = func,
+        .ctx = ctx,
+    };
+#ifdef CLIB_MENUS
+    watcher->timer = -1;
+#endif
+
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(watcher->fd < 0){
+        perror("inotify_init1");
+        return -1;
+    }
+    return 0;
+}
+
+static void clib__watch_free(ClibWatch* watch){
+    for(size_t i = 0; i < watch->name_count; ++i) free(watch->names[i]);
+    free(watch->names);
+    free(watch->path);
+}
+
+static void clib__watch_changes_clean(ClibWatchChanges* changes){
+    for(size_t i = clib__watch_changes_next(changes, 0); i < changes->capacity; i = clib__watch_changes_next(changes, i + 1)){
+        free((char*) changes->entries[i].key.data);
+    }
+    clib__watch_changes_free(changes);
+}
+
+CLIBAPI void clib_watcher_free(ClibWatcher* watcher){
+#ifdef CLIB_MENUS
+    if(watcher->loop != NULL){
+        clib_loop_remove_fd(watcher->loop, watcher->fd);
+        if(watcher->timer >= 0) clib_loop_remove_timer(watcher->loop, watcher->timer);
+    }
+#endif
+    if(watcher->fd >= 0) close(watcher->fd);
+
+    ClibWatchMap* watches = &watcher->watches;
+    for(size_t i = clib__watch_map_next(watches, 0); i < watches->capacity; i = clib__watch_map_next(watches, i + 1)){
+        clib__watch_free(&watches->entries[i].value);
+    }
+    clib__watch_map_free(watches);
+    clib__watch_changes_clean(&watcher->pending);
+
+    *watcher = (ClibWatcher) { .fd = -1 };
+}
+
+static void clib__watcher_queue(ClibWatcher* watcher, Cstr path, int changes);
+
+// Watches dir for name, or for everything when name is NULL. A directory
+// that just appeared can already have entries, made before its watch was
+// added, so with `report` each entry found is reported as created.
+static int clib__watcher_add_dir(ClibWatcher* watcher, Cstr dir, Cstr name, int recursive, int report){
+    int wd = inotify_add_watch(watcher->fd, dir, CLIB__WATCH_MASK);
+    if(wd < 0){
+        ERRO("Could not watch %s: %s", dir, strerror(errno));
+        return -1;
+    }
+
+    // Adding a directory twice gives back the same descriptor
+    int existed;
+    ClibWatch* watch = &clib__watch_map_emplace(&watcher->watches, wd, &existed)->value;
+    if(!existed) watch->path = clib__watcher_copy(dir);
+
+    if(name == NULL){
+        watch->whole = true;
+    } else {
+        watch->names = (char**) clib_safe_realloc(watch->names, (watch->name_count + 1) * sizeof(char*));
+        watch->names[watch->name_count++] = clib__watcher_copy(name);
+    }
+    if(!recursive || watch->recursive) return 0;
+    watch->recursive = true;
+
+    // Adding the subdirectories moves the map entries, so watch is not used past here
+    DIR* handle = opendir(dir);
+    if(handle == NULL) return 0;
+
+    struct dirent* entry;
+    while((entry = readdir(handle)) != NULL){
+        if(strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+
+        char* child = clib_format_text("%s/%s", dir, entry->d_name);
+        if(child == NULL) continue;
+
+        struct stat st;
+        int is_dir = entry->d_type == DT_DIR || (entry->d_type == DT_UNKNOWN && lstat(child, &st) == 0 && S_ISDIR(st.st_mode));
+        if(is_dir) clib__watcher_add_dir(watcher, child, NULL, true, report);
+        if(report) clib__watcher_queue(watcher, child, CLIB_WATCH_CREATED);
+        free(child);
+    }
+    closedir(handle);
+    return 0;
+}
+
+// A directory is watched as a whole, and recursive adds its subdirectories
+// too, including the ones created later. A file is watched through its
+// directory, so it may not exist yet as long as the directory does.
+CLIBAPI int clib_watcher_add(ClibWatcher* watcher, Cstr path, int recursive){
+    struct stat st;
+    if(stat(path, &st) == 0 && S_ISDIR(st.st_mode)) return clib__watcher_add_dir(watcher, path, NULL, recursive, false);
+
+    Cstr slash = strrchr(path, '/');
+    if(slash == NULL) return clib__watcher_add_dir(watcher, ".", path, false, false);
+    if(slash == path) return clib__watcher_add_dir(watcher, "/", path + 1, false, false);
+
+    char* dir = clib_format_text("%.*s", (int) (slash - path), path);
+    if(dir == NULL) return -1;
+    int result = clib__watcher_add_dir(watcher, dir, slash + 1, false, false);
+    free(dir);
+    return result;
+}
+
+static void clib__watcher_flush(ClibWatcher* watcher){
+    // The callbacks can cause new changes, which start the next burst
+    ClibWatchChanges changes = watcher->pending;
+    clib__watch_changes_init(&watcher->pending);
+    watcher->due_ms = 0;
+#ifdef CLIB_MENUS
+    if(watcher->timer >= 0) clib_loop_remove_timer(watcher->loop, watcher->timer);
+    watcher->timer = -1;
+#endif
+
+    for(size_t i = clib__watch_changes_next(&changes, 0); i < changes.capacity; i = clib__watch_changes_next(&changes, i + 1)){
+        watcher->func(changes.entries[i].key.data, changes.entries[i].value, watcher->ctx);
+    }
+    clib__watch_changes_clean(&changes);
+}
+
+#ifdef CLIB_MENUS
+static void clib__watcher_on_timer(ClibLoop* loop, void* ctx){
+    (void) loop;
+    ClibWatcher* watcher = (ClibWatcher*) ctx;
+    watcher->timer = -1; // it has already fired
+    clib__watcher_flush(watcher);
+}
+#endif
+
+static void clib__watcher_queue(ClibWatcher* watcher, Cstr path, int changes){
+    int existed;
+    ClibWatchChangesEntry* entry = clib__watch_changes_emplace(&watcher->pending, CLIB_VIEW(path), &existed);
+    if(!existed) entry->key.data = clib__watcher_copy(path);
+    entry->value |= changes;
+
+    if(watcher->due_ms != 0) return;
+    watcher->due_ms = clib__watcher_now_ms() + watcher->debounce_ms;
+#ifdef CLIB_MENUS
+    if(watcher->loop != NULL){
+        watcher->timer = clib_loop_add_timer(watcher->loop, watcher->debounce_ms, 0, clib__watcher_on_timer, watcher);
+
+        // Without a timer nothing would flush, and due_ms would hold back
+        // every later burst, so this one goes out from the next fd event
+        if(watcher->timer < 0) watcher->due_ms = 0;
+    }
+#endif
+}
+
+static void clib__watcher_event(ClibWatcher* watcher, const struct inotify_event* event){
+    ClibWatchMapEntry* found = clib__watch_map_find(&watcher->watches, (uint64_t) event->wd);
+    if(found == NULL) return;
+    ClibWatch* watch = &found->value;
+
+    // The directory is gone, or was unwatched
+    if(event->mask & IN_IGNORED){
+        clib__watch_free(watch);
+        clib__watch_map_remove(&watcher->watches, (uint64_t) event->wd);
+        return;
+    }
+
+    int changes =
+        (event->mask & (IN_CREATE | IN_MOVED_TO) ? CLIB_WATCH_CREATED : 0) |
+        (event->mask & (IN_MODIFY | IN_CLOSE_WRITE) ? CLIB_WATCH_MODIFIED : 0) |
+        (event->mask & (IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF) ? CLIB_WATCH_DELETED : 0);
+    if(changes == 0) return;
+
+    if(event->len == 0){
+        if(watch->whole) clib__watcher_queue(watcher, watch->path, changes);
+        return;
+    }
+
+    int wanted = watch->whole;
+    for(size_t i = 0; !wanted && i < watch->name_count; ++i) wanted = strcmp(watch->names[i], event->name) == 0;
+    if(!wanted) return;
+
+    char* path = clib_format_text("%s/%s", watch->path, event->name);
+    if(path == NULL) return;
+
+    if(watch->recursive && (event->mask & IN_ISDIR) && (changes & CLIB_WATCH_CREATED)){
+        clib__watcher_add_dir(watcher, path, NULL, true, true);
+    }
+    clib__watcher_queue(watcher, path, changes);
+    free(path);
+}
+
+static void clib__watcher_read(ClibWatcher* watcher){
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while(true){
+        ssize_t bytes = read(watcher->fd, buffer, sizeof(buffer));
+        if(bytes < 0 && errno == EINTR) continue;
+        if(bytes <= 0) return;
+
+        for(char* at = buffer; at < buffer + bytes; ){
+            const struct inotify_event* event = (const struct inotify_event*) at;
+            at += sizeof(struct inotify_event) + event->len;
+
+            // The kernel dropped events, so anything may have changed
+            if(event->mask & IN_Q_OVERFLOW){
+                ClibWatchMap* watches = &watcher->watches;
+                for(size_t i = clib__watch_map_next(watches, 0); i < watches->capacity; i = clib__watch_map_next(watches, i + 1)){
+                    clib__watcher_queue(watcher, watches->entries[i].value.path, CLIB_WATCH_MODIFIED);
+                }
+                continue;
+            }
+            clib__watcher_event(watcher, event);
+        }
+    }
+}
+
+// Milliseconds until the pending changes are due, or -1 when there are none
+CLIBAPI int clib_watcher_timeout(const ClibWatcher* watcher){
+    if(watcher->due_ms == 0) return -1;
+    int64_t wait = watcher->due_ms - clib__watcher_now_ms();
+    return wait > 0 ? (int) wait : 0;
+}
+
+// Reads what the kernel has queued without blocking, and reports the
+// changes whose debounce window has passed
+CLIBAPI void clib_watcher_process(ClibWatcher* watcher){
+    clib__watcher_read(watcher);
+    if(watcher->due_ms != 0 && clib__watcher_now_ms() >= watcher->due_ms) clib__watcher_flush(watcher);
+}
+
+#ifdef CLIB_MENUS
+static void clib__watcher_on_fd(ClibLoop* loop, int fd, short revents, void* ctx){
+    (void) loop;
+    (void) fd;
+    (void) revents;
+    ClibWatcher* watcher = (ClibWatcher*) ctx;
+    clib__watcher_read(watcher);
+
+    // The burst could not get a timer, see clib__watcher_queue
+    if(watcher->timer < 0 && watcher->pending.count > 0) clib__watcher_flush(watcher);
+}
+
+// The loop reads the events as they arrive and reports each burst from a
+// timer, so nothing runs while the watched files are left alone
+CLIBAPI int clib_watcher_attach(ClibWatcher* watcher, ClibLoop* loop){
+    if(clib_loop_add_fd(loop, watcher->fd, POLLIN, clib__watcher_on_fd, watcher) != 0) return -1;
+    watcher->loop = loop;
+    return 0;
+}
+#endif
+#endif // CLIB_WATCHER
+
+#ifdef CLIB_CSV
+// Bit i of each mask stands for byte i of a 64-byte block
+typedef struct {
+    uint64_t delimiters;
+    uint64_t quotes;
+    uint64_t newlines;
+} ClibCsvMasks;
+
+static ClibCsvMasks clib__csv_classify_scalar(const char* block, char delimiter){
+    ClibCsvMasks masks = {0};
+    for(int i = 0; i < 64; ++i){
+        masks.delimiters |= (uint64_t) (block[i] == delimiter) << i;
+        masks.quotes |= (uint64_t) (block[i] == '"') << i;
+        masks.newlines |= (uint64_t) (block[i] == '\n') << i;
+    }
+    return masks;
+}
+
+#ifdef CLIB_STR_SIMD
+static ClibCsvMasks clib__csv_classify_sse2(const char* block, char delimiter){
+    const __m128i delimiter_bytes = _mm_set1_epi8(delimiter);
+    const __m128i quote_bytes = _mm_set1_epi8('"');
+    const __m128i newline_bytes = _mm_set1_epi8('\n');
+
+    ClibCsvMasks masks = {0};
+    for(int i = 0; i < 64; i += 16){
+        __m128i chunk = _mm_loadu_si128((const __m128i*) (block + i));
+        masks.delimiters |= (uint64_t) (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, delimiter_bytes)) << i;
+        masks.quotes |= (uint64_t) (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote_bytes)) << i;
+        masks.newlines |= (uint64_t) (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline_bytes)) << i;
+    }
+    return masks;
+}
+
+__attribute__((target("avx2")))
+static ClibCsvMasks clib__csv_classify_avx2(const char* block, char delimiter){
+    const __m256i delimiter_bytes = _mm256_set1_epi8(delimiter);
+    const __m256i quote_bytes = _mm256_set1_epi8('"');
+    const __m256i newline_bytes = _mm256_set1_epi8('\n');
+
+    ClibCsvMasks masks = {0};
+    for(int i = 0; i < 64; i += 32){
+        __m256i chunk = _mm256_loadu_si256((const __m256i*) (block + i));
+        masks.delimiters |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, delimiter_bytes)) << i;
+        masks.quotes |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, quote_bytes)) << i;
+        masks.newlines |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline_bytes)) << i;
+    }
+    return masks;
 }
+#endif // CLIB_STR_SIMD
 
-CLIBAPI char* clib_shift_args(int *argc, char ***argv) {
-    assert(*argc > 0);
-    char *result = **argv;
-    *argc -= 1;
-    *argv += 1;
-    return result;
+static ClibCsvMasks clib__csv_classify(const char* block, char delimiter){
+    CLIB__SIMD_DISPATCH(clib__csv_classify, block, delimiter);
 }
 
-CLIBAPI Cstr clib_color(int color, int bg) {
-    if (color < 0 || color > 255) return "";
+// Bit i becomes the xor of bits 0 to i: set from an opening quote up to
+// the byte before its closing one. A doubled quote closes and reopens.
+static inline uint64_t clib__prefix_xor(uint64_t bits){
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
 
-    char where_code[12], color_string[12];
-    ITOA(where_code, bg + 3);
-    ITOA(color_string, color);
+// Classifies the block at csv->block, padding the end of the buffer
+static void clib__csv_load_block(ClibCsv* csv){
+    char padded[64];
+    const char* block = csv->data + csv->block;
+    if(csv->length - csv->block < 64){
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, block, csv->length - csv->block);
+        block = padded;
+    }
 
-    return (Cstr) clib_format_text("\e[%s8;5;%sm", where_code, color_string);
+    ClibCsvMasks masks = clib__csv_classify(block, csv->delimiter);
+    uint64_t inside = clib__prefix_xor(masks.quotes) ^ csv->inside;
+    csv->inside = (uint64_t) 0 - (inside >> 63);
+    csv->structural = (masks.delimiters | masks.newlines) & ~inside;
 }
 
-CLIBAPI void clib_clear_screen() {
-#ifdef _WIN32
-    system("cls"); // Clear screen for Windows
-#else
-    system("clear"); // Clear screen for Linux and macOS
-#endif
+// The offset of the next delimiter or newline outside quotes, or the length
+static size_t clib__csv_next_structural(ClibCsv* csv){
+    while(csv->structural == 0){
+        csv->block += 64;
+        if(csv->block >= csv->length) return csv->length;
+        clib__csv_load_block(csv);
+    }
+
+    size_t at = csv->block + clib__ctz64(csv->structural);
+    csv->structural &= csv->structural - 1;
+    return at;
 }
 
+// Drops the quotes around a field and undoes its doubled quotes in place
+static CstrView clib__csv_unquote(char* field, size_t length){
+    if(length < 2 || field[0] != '"') return (CstrView) { field, length };
 
-CLIBAPI void clib_print_color_table(){
-    for(int i = 0; i < 256; i++){
-        if(i % 21 == 0) printf("\n");
-        
-        printf("%s%3d ", clib_color(i, 0), i);
+    char* text = field + 1;
+    length -= field[length - 1] == '"' ? 2 : 1;
+
+    size_t quote = clib_str_find_any((CstrView) { text, length }, CLIB_VIEW_LITERAL("\""));
+    if(quote == CLIB_STR_NPOS) return (CstrView) { text, length };
+
+    size_t write = quote;
+    for(size_t read = quote; read < length; ++read){
+        text[write++] = text[read];
+        if(text[read] == '"' && read + 1 < length && text[read + 1] == '"') read++;
     }
-    printf("%s\n", RESET);
+    return (CstrView) { text, write };
 }
 
+CLIBAPI void clib_csv_init(ClibCsv* csv, char* data, size_t length, char delimiter){
+    *csv = (ClibCsv) { .data = data, .length = length, .delimiter = delimiter };
+    if(length > 0) clib__csv_load_block(csv);
+}
 
-CLIBAPI void clib_copy_file(const char *source, const char *destination) {
-    FILE *srcFile = fopen(source, "r");
-    if (srcFile == NULL) {
-        perror("Error opening source file");
-        exit(EXIT_FAILURE);
+// Maps the file copy-on-write, so only the pages with quoted fields are
+// ever copied. Returns -1 if it cannot be read.
+CLIBAPI int clib_csv_open(ClibCsv* csv, Cstr path, char delimiter){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        ERRO("Could not open %s: %s", path, strerror(errno));
+        return -1;
     }
 
-    FILE *destFile = fopen(destination, "w");
-    if (destFile == NULL) {
-        perror("Error opening destination file");
-        fclose(srcFile);
-        exit(EXIT_FAILURE);
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        perror("fstat");
+        close(fd);
+        return -1;
     }
 
-    char buffer[256];
-    size_t bytesRead;
-    while ((bytesRead = fread(buffer, 1, sizeof(buffer), srcFile)) > 0) {
-        if (fwrite(buffer, 1, bytesRead, destFile) != bytesRead) {
-            perror("Error writing to destination file");
-            fclose(srcFile);
-            fclose(destFile);
-            exit(EXIT_FAILURE);
+    size_t size = (size_t) st.st_size;
+    char* data = NULL;
+    if(size > 0){
+        data = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if(data == MAP_FAILED){
+            perror("mmap");
+            close(fd);
+            return -1;
         }
+        madvise(data, size, MADV_SEQUENTIAL);
     }
+    close(fd);
 
-    fclose(srcFile);
-    fclose(destFile);
+    clib_csv_init(csv, data, size, delimiter);
+    csv->mapped_size = size;
+    return 0;
 }
 
-CLIBAPI void clib_move_file(const char *source, const char *destination) {
-    if (rename(source, destination) != 0) {
-        perror("Error moving/renaming file");
-        exit(EXIT_FAILURE);
-    }
+CLIBAPI void clib_csv_close(ClibCsv* csv){
+    if(csv->mapped_size > 0) munmap(csv->data, csv->mapped_size);
+    free(csv->fields);
+    *csv = (ClibCsv) {0};
 }
 
-CLIBAPI long clib_file_size(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (file == NULL) {
-        perror("Error opening file");
-        exit(EXIT_FAILURE);
-    }
+// Reads the next record into csv->fields. Returns false at the end.
+CLIBAPI int clib_csv_next(ClibCsv* csv){
+    while(csv->position < csv->length){
+        csv->field_count = 0;
+        int blank = false;
 
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fclose(file);
-    return size;
-}
+        while(true){
+            size_t end = clib__csv_next_structural(csv);
+            int last = end >= csv->length || csv->data[end] == '\n';
 
-CLIBAPI int clib_file_exists(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (file != NULL) {
-        fclose(file);
-        return 1;
+            char* field = csv->data + csv->position;
+            size_t length = end - csv->position;
+            if(last && length > 0 && field[length - 1] == '\r') length--;
+            blank = last && csv->field_count == 0 && length == 0;
+
+            if(csv->field_count == csv->field_capacity){
+                csv->field_capacity = csv->field_capacity ? csv->field_capacity * 2 : 16;
+                csv->fields = (CstrView*) clib_safe_realloc(csv->fields, csv->field_capacity * sizeof(CstrView));
+            }
+            csv->fields[csv->field_count++] = clib__csv_unquote(field, length);
+            csv->position = end + 1;
+
+            if(last) break;
+        }
+
+        if(!blank) return true;
     }
-    return 0;
+    return false;
 }
 
-CLIBAPI void clib_append_file(const char *filename, const char *data) {
-    FILE *file = fopen(filename, "a");
-    if (file == NULL) {
-        perror("Error opening file for appending");
-        exit(EXIT_FAILURE);
-    }
-    if (fputs(data, file) == EOF) {
-        perror("Error appending to file");
-        fclose(file);
-        exit(EXIT_FAILURE);
+// Splits the buffer into `parts` ranges of whole records: part i runs from
+// starts[i] to starts[i + 1], and starts[parts] is the length. The quotes
+// before each cut are counted, so a newline inside quotes is never taken
+// for the end of a record. Some parts can be empty. Returns parts.
+CLIBAPI size_t clib_csv_split(Cstr data, size_t length, size_t parts, size_t* starts){
+    size_t counted = 0; // quotes are counted up to here
+    int inside = false;
+
+    starts[0] = 0;
+    for(size_t i = 1; i < parts; ++i){
+        size_t cut = length / parts * i;
+        if(cut < starts[i - 1]) cut = starts[i - 1];
+
+        inside ^= clib_str_count_byte((CstrView) { data + counted, cut - counted }, '"') & 1;
+        counted = cut;
+
+        // A part starts right after the first newline outside quotes
+        size_t at = cut;
+        int quoted = inside;
+        if(quoted || (at > 0 && data[at - 1] != '\n')){
+            for(; at < length; ++at){
+                if(data[at] == '"') quoted = !quoted;
+                else if(data[at] == '\n' && !quoted) break;
+            }
+            if(at < length) at++;
+        }
+        starts[i] = at;
     }
-    fclose(file);
+    starts[parts] = length;
+    return parts;
 }
 
-CLIBAPI void clib_create_file(const char *filename) {
-    FILE *file = fopen(filename, "w");
-    if (file == NULL) {
-        perror("Error creating file");
-        exit(EXIT_FAILURE);
-    }
-    fclose(file);
+typedef struct {
+    ClibCsv chunk;
+    size_t index;
+    ClibCsvChunkFunc func;
+    void* ctx;
+    pthread_t thread;
+} ClibCsvWorker;
+
+static void* clib__csv_worker(void* arg){
+    ClibCsvWorker* worker = (ClibCsvWorker*) arg;
+    worker->func(&worker->chunk, worker->index, worker->ctx);
+    return NULL;
 }
 
-CLIBAPI void clib_write_file(const char *filename, const char *data, Cstr mode) {
-    if(
-        strcmp(mode, "w") &&
-        strcmp(mode, "w+") &&
-        strcmp(mode, "a") &&
-        strcmp(mode, "a+")
-    ) {
-        PANIC("Writing file using invalid mode: %s", mode);
+// Splits the text of csv into one part per thread with clib_csv_split and
+// calls func for each on its own thread, with a reader over that part.
+// func runs clib_csv_next on it; the readers are closed afterwards.
+CLIBAPI int clib_csv_parallel(const ClibCsv* csv, size_t threads, ClibCsvChunkFunc func, void* ctx){
+    if(threads == 0) threads = 1;
+    if(threads > CLIB_CSV_MAX_THREADS) threads = CLIB_CSV_MAX_THREADS;
+
+    size_t starts[CLIB_CSV_MAX_THREADS + 1];
+    clib_csv_split(csv->data, csv->length, threads, starts);
+
+    ClibCsvWorker workers[CLIB_CSV_MAX_THREADS];
+    int result = 0;
+    size_t started = 0;
+    for(; started < threads; ++started){
+        ClibCsvWorker* worker = &workers[started];
+        *worker = (ClibCsvWorker) { .index = started, .func = func, .ctx = ctx };
+        clib_csv_init(&worker->chunk, csv->data + starts[started], starts[started + 1] - starts[started], csv->delimiter);
+
+        if(pthread_create(&worker->thread, NULL, clib__csv_worker, worker) != 0){
+            ERRO("Could not start a CSV worker thread");
+            result = -1;
+            break;
+        }
     }
 
-    FILE *file = fopen(filename, mode);
-    if (file == NULL) {
-        perror("Error opening file for writing");
-        exit(EXIT_FAILURE);
-    }
-    if (fputs(data, file) == EOF) {
-        perror("Error writing to file");
-        fclose(file);
-        exit(EXIT_FAILURE);
+    for(size_t i = 0; i < started; ++i){
+        pthread_join(workers[i].thread, NULL);
+        clib_csv_close(&workers[i].chunk);
     }
-    fclose(file);
+    if(started < threads) clib_csv_close(&workers[started].chunk);
+    return result;
+}
+#endif // CLIB_CSV
+
+#ifdef CLIB_METRICS
+#define CLIB__METRICS_HISTOGRAM_SLOTS (CLIB_METRICS_BUCKETS + 1) // the buckets and the sum
+
+static ClibMetric clib__metrics[CLIB_METRICS_MAX] = {
+    [CLIB_METRIC_FILE_READ_BYTES] = { "clib_file_read_bytes_total", "Bytes read by the file functions", CLIB_METRIC_COUNTER, 0 },
+    [CLIB_METRIC_FILE_WRITTEN_BYTES] = { "clib_file_written_bytes_total", "Bytes written by the file functions", CLIB_METRIC_COUNTER, 1 },
+    [CLIB_METRIC_COMMANDS] = { "clib_commands_total", "Commands run by clib_execute_command", CLIB_METRIC_COUNTER, 2 },
+    [CLIB_METRIC_COMMAND_SECONDS] = { "clib_command_duration_seconds", "Time clib_execute_command took", CLIB_METRIC_HISTOGRAM, 3 },
+    [CLIB_METRIC_LOG_LINES] = { "clib_log_lines_total", "Log lines written", CLIB_METRIC_COUNTER, 3 + CLIB__METRICS_HISTOGRAM_SLOTS },
+    [CLIB_METRIC_LOG_DROPPED] = { "clib_log_dropped_total", "Log lines held back by sampling or rate limits", CLIB_METRIC_COUNTER, 4 + CLIB__METRICS_HISTOGRAM_SLOTS },
+};
+static _Atomic uint32_t clib__metrics_count = CLIB__METRIC_BUILTIN_COUNT;
+static uint32_t clib__metrics_slots_used = 5 + CLIB__METRICS_HISTOGRAM_SLOTS;
+static uint32_t clib__metrics_gauges_used = 0;
+static pthread_mutex_t clib__metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Gauges are set rather than summed, so they are shared and hold the bits of a double
+static _Atomic uint64_t clib__metrics_gauges[CLIB_METRICS_MAX];
+
+static _Atomic(ClibMetricsShard*) clib__metrics_shards = NULL;
+static CLIB_THREAD_LOCAL ClibMetricsShard* clib__metrics_shard = NULL;
+static pthread_once_t clib__metrics_once = PTHREAD_ONCE_INIT;
+static pthread_key_t clib__metrics_key;
+
+static void clib__metrics_release(void* shard){
+    atomic_store_explicit(&((ClibMetricsShard*) shard)->owned, false, memory_order_release);
 }
 
-CLIBAPI char* clib_read_file(const char *filename) {
-    FILE *file = fopen(filename, "r");
-    if (file == NULL) {
-        perror("Error opening file for reading");
-        return NULL;
+static void clib__metrics_make_key(){
+    pthread_key_create(&clib__metrics_key, clib__metrics_release);
+}
+
+static ClibMetricsShard* clib__metrics_get_shard(){
+    if(LIKELY(clib__metrics_shard != NULL)) return clib__metrics_shard;
+    pthread_once(&clib__metrics_once, clib__metrics_make_key);
+
+    // Take over the shard of a thread that exited, or add a new one.
+    // Shards are never freed, so the list can be walked without a lock.
+    ClibMetricsShard* shard = atomic_load_explicit(&clib__metrics_shards, memory_order_acquire);
+    for(; shard != NULL; shard = shard->next){
+        int owned = false;
+        if(atomic_load_explicit(&shard->owned, memory_order_relaxed) == false &&
+            atomic_compare_exchange_strong_explicit(&shard->owned, &owned, true,
+                memory_order_acquire, memory_order_relaxed)) break;
     }
 
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    if(shard == NULL){
+        shard = (ClibMetricsShard*) aligned_alloc(__alignof__(ClibMetricsShard), sizeof(ClibMetricsShard));
+        if(shard == NULL){
+            fprintf(stderr, "Memory allocation error\n");
+            exit(EXIT_FAILURE);
+        }
+        memset(shard, 0, sizeof(ClibMetricsShard));
+        shard->owned = true;
+
+        ClibMetricsShard* head = atomic_load_explicit(&clib__metrics_shards, memory_order_relaxed);
+        do {
+            shard->next = head;
+        } while(!atomic_compare_exchange_weak_explicit(&clib__metrics_shards, &head, shard,
+            memory_order_release, memory_order_relaxed));
+    }
 
-    char *buffer = (char*)malloc(file_size + 1);
-    if (buffer == NULL) {
-        perror("Error allocating memory");
-        fclose(file);
-        return NULL;
+    pthread_setspecific(clib__metrics_key, shard);
+    clib__metrics_shard = shard;
+    return shard;
+}
+
+// Returns the id of the metric, which is the one already registered under
+// the name if there is one, or -1 when CLIB_METRICS_MAX or
+// CLIB_METRICS_SLOTS would be exceeded
+static int clib__metrics_register(Cstr name, Cstr help, ClibMetricKind kind){
+    pthread_mutex_lock(&clib__metrics_lock);
+    uint32_t count = atomic_load_explicit(&clib__metrics_count, memory_order_relaxed);
+
+    int id = -1;
+    for(uint32_t i = 0; i < count; ++i){
+        if(strcmp(clib__metrics[i].name, name) == 0){
+            id = clib__metrics[i].kind == kind ? (int) i : -1;
+            if(id < 0) ERRO("Metric %s is already registered as another kind", name);
+            pthread_mutex_unlock(&clib__metrics_lock);
+            return id;
+        }
     }
 
-    size_t bytesRead = fread(buffer, 1, file_size, file);
-    if (bytesRead != file_size) {
-        perror("Error reading file");
-        free(buffer);
-        fclose(file);
-        return NULL;
+    uint32_t slots = kind == CLIB_METRIC_COUNTER ? 1 : kind == CLIB_METRIC_HISTOGRAM ? CLIB__METRICS_HISTOGRAM_SLOTS : 0;
+    if(count == CLIB_METRICS_MAX || clib__metrics_slots_used + slots > CLIB_METRICS_SLOTS){
+        ERRO("Cannot register metric %s, raise CLIB_METRICS_MAX or CLIB_METRICS_SLOTS", name);
+    } else {
+        uint32_t slot = kind == CLIB_METRIC_GAUGE ? clib__metrics_gauges_used++ : clib__metrics_slots_used;
+        clib__metrics_slots_used += slots;
+        clib__metrics[count] = (ClibMetric) { .name = name, .help = help, .kind = kind, .slot = slot };
+
+        // Publishes the entry to the exporter, which does not take the lock
+        atomic_store_explicit(&clib__metrics_count, count + 1, memory_order_release);
+        id = (int) count;
     }
 
-    buffer[file_size] = '\0';
+    pthread_mutex_unlock(&clib__metrics_lock);
+    return id;
+}
 
-    fclose(file);
-    return buffer;
+// The names and help texts are not copied
+CLIBAPI int clib_metrics_counter(Cstr name, Cstr help){
+    return clib__metrics_register(name, help, CLIB_METRIC_COUNTER);
 }
 
-CLIBAPI void clib_delete_file(const char *filename) {
-    if (remove(filename) != 0) {
-        perror("Error deleting file");
-        exit(EXIT_FAILURE);
-    }
+CLIBAPI int clib_metrics_gauge(Cstr name, Cstr help){
+    return clib__metrics_register(name, help, CLIB_METRIC_GAUGE);
 }
 
-CLIBAPI void* clib_safe_malloc(size_t size) {
-    void *ptr = malloc(size);
-    if (ptr == NULL) {
-        fprintf(stderr, "Memory allocation error\n");
-        exit(EXIT_FAILURE);
-    }
-    return ptr;
+CLIBAPI int clib_metrics_histogram(Cstr name, Cstr help){
+    return clib__metrics_register(name, help, CLIB_METRIC_HISTOGRAM);
 }
 
-CLIBAPI void* clib_safe_calloc(size_t nmemb, size_t size) {
-    void *ptr = calloc(nmemb, size);
-    if (ptr == NULL) {
-        fprintf(stderr, "Memory allocation error\n");
-        exit(EXIT_FAILURE);
+CLIBAPI uint64_t clib_metrics_now_ns(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static inline void clib__metrics_bump(_Atomic uint64_t* slot, uint64_t amount){
+    // Not a fetch_add: no other thread writes to the shard
+    atomic_store_explicit(slot, atomic_load_explicit(slot, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+// Also rejects negative ids, which wrap around
+static inline int clib__metrics_valid(int id){
+    return (uint32_t) id < atomic_load_explicit(&clib__metrics_count, memory_order_acquire);
+}
+
+CLIBAPI void clib_metrics_add(int id, uint64_t amount){
+    if(UNLIKELY(!clib__metrics_valid(id))) return;
+    clib__metrics_bump(&clib__metrics_get_shard()->slots[clib__metrics[id].slot], amount);
+}
+
+// The first bucket ends at 1us and each one after it is four times as wide
+static inline uint32_t clib__metrics_bucket(uint64_t ns){
+    if(ns <= 1000) return 0;
+    uint32_t bucket = (65 - clib__clz64((ns - 1) / 1000 | 1)) / 2;
+    return bucket < CLIB_METRICS_BUCKETS - 1 ? bucket : CLIB_METRICS_BUCKETS - 1;
+}
+
+CLIBAPI void clib_metrics_observe(int id, uint64_t ns){
+    if(UNLIKELY(!clib__metrics_valid(id))) return;
+    _Atomic uint64_t* slots = &clib__metrics_get_shard()->slots[clib__metrics[id].slot];
+    clib__metrics_bump(&slots[clib__metrics_bucket(ns)], 1);
+    clib__metrics_bump(&slots[CLIB_METRICS_BUCKETS], ns);
+}
+
+CLIBAPI void clib_metrics_set(int id, double value){
+    if(UNLIKELY(!clib__metrics_valid(id))) return;
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    atomic_store_explicit(&clib__metrics_gauges[clib__metrics[id].slot], bits, memory_order_relaxed);
+}
+
+CLIBAPI void clib_metrics_gauge_add(int id, double delta){
+    if(UNLIKELY(!clib__metrics_valid(id))) return;
+    _Atomic uint64_t* gauge = &clib__metrics_gauges[clib__metrics[id].slot];
+    uint64_t bits = atomic_load_explicit(gauge, memory_order_relaxed);
+    uint64_t next;
+    do {
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        value += delta;
+        memcpy(&next, &value, sizeof(next));
+    } while(!atomic_compare_exchange_weak_explicit(gauge, &bits, next, memory_order_relaxed, memory_order_relaxed));
+}
+
+static uint64_t clib__metrics_sum(uint32_t slot){
+    uint64_t sum = 0;
+    ClibMetricsShard* shard = atomic_load_explicit(&clib__metrics_shards, memory_order_acquire);
+    for(; shard != NULL; shard = shard->next){
+        sum += atomic_load_explicit(&shard->slots[slot], memory_order_relaxed);
     }
-    return ptr;
+    return sum;
 }
 
-CLIBAPI void* clib_safe_realloc(void *ptr, size_t size) {
-    void *new_ptr = realloc(ptr, size);
-    if (new_ptr == NULL) {
-        fprintf(stderr, "Memory reallocation error\n");
-        exit(EXIT_FAILURE);
+// The total of a counter, or the number of observations of a histogram
+CLIBAPI uint64_t clib_metrics_value(int id){
+    if(!clib__metrics_valid(id)) return 0;
+    ClibMetric* metric = &clib__metrics[id];
+    if(metric->kind == CLIB_METRIC_COUNTER) return clib__metrics_sum(metric->slot);
+    if(metric->kind == CLIB_METRIC_GAUGE) return 0;
+
+    uint64_t count = 0;
+    for(uint32_t i = 0; i < CLIB_METRICS_BUCKETS; ++i) count += clib__metrics_sum(metric->slot + i);
+    return count;
+}
+
+CLIBAPI double clib_metrics_gauge_value(int id){
+    if(!clib__metrics_valid(id) || clib__metrics[id].kind != CLIB_METRIC_GAUGE) return 0;
+    uint64_t bits = atomic_load_explicit(&clib__metrics_gauges[clib__metrics[id].slot], memory_order_relaxed);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+CLIBAPI ClibMetricsTimer clib_metrics_timer_begin(int id){
+    return (ClibMetricsTimer) { .id = id, .begin_ns = clib_metrics_now_ns() };
+}
+
+CLIBAPI void clib_metrics_timer_end(ClibMetricsTimer* timer){
+    clib_metrics_observe(timer->id, clib_metrics_now_ns() - timer->begin_ns);
+}
+
+static void clib__metrics_write_double(FILE* file, double value){
+    if(value != value) fputs("NaN", file);
+    else if(value > 1.7976931348623157e308) fputs("+Inf", file);
+    else if(value < -1.7976931348623157e308) fputs("-Inf", file);
+    else {
+        char text[CLIB_DTOA_SIZE];
+        fwrite(text, 1, clib_dtoa(text, value), file);
     }
-    return new_ptr;
 }
 
-CLIBAPI void clib_safe_free(void **ptr) {
-    if (ptr != NULL && *ptr != NULL) {
-        free(*ptr);
-        *ptr = NULL;
+static void clib__metrics_write_u64(FILE* file, uint64_t value){
+    char text[CLIB_DTOA_SIZE];
+    fwrite(text, 1, clib_u64toa(text, value), file);
+}
+
+static void clib__metrics_write_help(FILE* file, Cstr help){
+    for(Cstr c = help; *c; ++c){
+        if(*c == '\\') fputs("\\\\", file);
+        else if(*c == '\n') fputs("\\n", file);
+        else fputc(*c, file);
     }
 }
 
-#ifndef _WIN32
-CLIBAPI char* clib_execute_command(const char* command) {
-    char buffer[128];
-    char *result = NULL;
-    size_t result_size = 0;
-    FILE *pipe = popen(command, "r");
-    if (!pipe) {
-        return NULL;
+// Writes every metric in the Prometheus text exposition format. Histograms
+// are written in seconds.
+CLIBAPI int clib_metrics_write(FILE* file){
+    uint32_t count = atomic_load_explicit(&clib__metrics_count, memory_order_acquire);
+    static Cstr kinds[] = { "counter", "gauge", "histogram" };
+
+    for(uint32_t i = 0; i < count; ++i){
+        ClibMetric* metric = &clib__metrics[i];
+        if(metric->help != NULL){
+            fprintf(file, "# HELP %s ", metric->name);
+            clib__metrics_write_help(file, metric->help);
+            fputc('\n', file);
+        }
+        fprintf(file, "# TYPE %s %s\n", metric->name, kinds[metric->kind]);
+
+        if(metric->kind == CLIB_METRIC_COUNTER){
+            fprintf(file, "%s ", metric->name);
+            clib__metrics_write_u64(file, clib__metrics_sum(metric->slot));
+        } else if(metric->kind == CLIB_METRIC_GAUGE){
+            fprintf(file, "%s ", metric->name);
+            clib__metrics_write_double(file, clib_metrics_gauge_value((int) i));
+        } else {
+            // Prometheus buckets are cumulative
+            uint64_t cumulative = 0;
+            double bound = 1e-6;
+            for(uint32_t b = 0; b < CLIB_METRICS_BUCKETS; ++b, bound *= 4){
+                cumulative += clib__metrics_sum(metric->slot + b);
+                fprintf(file, "%s_bucket{le=\"", metric->name);
+                if(b + 1 < CLIB_METRICS_BUCKETS) clib__metrics_write_double(file, bound);
+                else fputs("+Inf", file);
+                fputs("\"} ", file);
+                clib__metrics_write_u64(file, cumulative);
+                fputc('\n', file);
+            }
+            fprintf(file, "%s_sum ", metric->name);
+            clib__metrics_write_double(file, (double) clib__metrics_sum(metric->slot + CLIB_METRICS_BUCKETS) / 1e9);
+            fprintf(file, "\n%s_count ", metric->name);
+            clib__metrics_write_u64(file, cumulative);
+        }
+        fputc('\n', file);
     }
+    return ferror(file) ? -1 : 0;
+}
 
-    while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-        size_t buffer_len = strlen(buffer);
-        result = realloc(result, result_size + buffer_len + 1);
-        if (!result) {
-            pclose(pipe);
-            return NULL;
+// Sets errno and returns -1 on failure
+static int clib__metrics_export(Cstr target){
+    if(strncmp(target, "unix:", 5) == 0){
+        struct sockaddr_un address = { .sun_family = AF_UNIX };
+        if(strlen(target + 5) >= sizeof(address.sun_path)){
+            errno = ENAMETOOLONG;
+            return -1;
         }
-        strcpy(result + result_size, buffer);
-        result_size += buffer_len;
+        strcpy(address.sun_path, target + 5);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(fd < 0) return -1;
+        if(connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0){
+            int error = errno;
+            close(fd);
+            errno = error;
+            return -1;
+        }
+
+        FILE* file = fdopen(fd, "w");
+        if(file == NULL){
+            int error = errno;
+            close(fd);
+            errno = error;
+            return -1;
+        }
+        int result = clib_metrics_write(file);
+        if(fclose(file) != 0) result = -1;
+        return result;
     }
 
-    pclose(pipe);
+    // Written next to the target and renamed over it, so a reader never
+    // sees half of it
+    char* temporary = clib_format_text("%s.tmp", target);
+    if(temporary == NULL) return -1;
+
+    int result = -1;
+    FILE* file = fopen(temporary, "w");
+    if(file != NULL){
+        result = clib_metrics_write(file);
+        if(fclose(file) != 0) result = -1;
+        if(result == 0) result = rename(temporary, target);
+    }
+    if(result != 0){
+        int error = errno;
+        remove(temporary);
+        errno = error;
+    }
+    free(temporary);
     return result;
 }
 
-CLIBAPI char* clib_get_env(const char* varname) {
-    return getenv(varname);
+// Writes the metrics once to target, a file path or "unix:<path>" for a
+// listening Unix stream socket
+CLIBAPI int clib_metrics_export(Cstr target){
+    if(clib__metrics_export(target) != 0){
+        ERRO("Could not export metrics to %s: %s", target, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int running;
+    int interval_ms;
+    char* target;
+} ClibMetricsExporter;
+
+static ClibMetricsExporter clib__metrics_exporter = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static void* clib__metrics_export_loop(void* arg){
+    ClibMetricsExporter* exporter = (ClibMetricsExporter*) arg;
+
+    pthread_mutex_lock(&exporter->lock);
+    while(exporter->running){
+        struct timespec due;
+        clock_gettime(CLOCK_REALTIME, &due);
+        due.tv_sec += exporter->interval_ms / 1000;
+        due.tv_nsec += (long) (exporter->interval_ms % 1000) * 1000000;
+        if(due.tv_nsec >= 1000000000){
+            due.tv_sec++;
+            due.tv_nsec -= 1000000000;
+        }
+        while(exporter->running && pthread_cond_timedwait(&exporter->wake, &exporter->lock, &due) == 0);
+
+        // The last export happens on stop, so the target ends with the final values
+        pthread_mutex_unlock(&exporter->lock);
+        if(clib__metrics_export(exporter->target) != 0){
+            ERRO_EVERY_MS(60000, "Could not export metrics to %s: %s", exporter->target, strerror(errno));
+        }
+        pthread_mutex_lock(&exporter->lock);
+    }
+    pthread_mutex_unlock(&exporter->lock);
+    return NULL;
 }
 
-CLIBAPI int set_envclib_(const char* varname, const char* value, int overwrite) {
-    return setenv(varname, value, overwrite);
+// Exports to target (see clib_metrics_export) every interval_ms from a
+// background thread, until clib_metrics_export_stop
+CLIBAPI int clib_metrics_export_start(Cstr target, int interval_ms){
+    ClibMetricsExporter* exporter = &clib__metrics_exporter;
+    if(exporter->target != NULL){
+        ERRO("The metrics exporter is already running");
+        return -1;
+    }
+
+    size_t size = strlen(target) + 1;
+    exporter->target = (char*) clib_safe_malloc(size);
+    memcpy(exporter->target, target, size);
+    exporter->interval_ms = interval_ms > 0 ? interval_ms : 1000;
+    exporter->running = true;
+
+    if(pthread_create(&exporter->thread, NULL, clib__metrics_export_loop, exporter) != 0){
+        ERRO("Could not start the metrics exporter thread");
+        free(exporter->target);
+        exporter->target = NULL;
+        return -1;
+    }
+    return 0;
 }
 
-CLIBAPI int clib_unset_env(const char* varname) {
-    return unsetenv(varname);
+CLIBAPI void clib_metrics_export_stop(){
+    ClibMetricsExporter* exporter = &clib__metrics_exporter;
+    if(exporter->target == NULL) return;
+
+    pthread_mutex_lock(&exporter->lock);
+    exporter->running = false;
+    pthread_cond_signal(&exporter->wake);
+    pthread_mutex_unlock(&exporter->lock);
+
+    pthread_join(exporter->thread, NULL);
+    free(exporter->target);
+    exporter->target = NULL;
 }
-#endif
+#endif // CLIB_METRICS
 
 #endif // CLIB_IMPLEMENTATION
 // END [IMPLEMENTATIONS] END//
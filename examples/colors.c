@@ -10,5 +10,9 @@ int main(){
     printf("%s%s%s\n", BOLD, "Bold text", RESET);
     printf("%s%s%s\n", UNDERLINE, "Underlined text", RESET);
 
+    char orange[CLIB_COLOR_RGB_SIZE];
+    clib_color_rgb(orange, 255, 135, 0, 0);
+    printf("%s%s%s\n", orange, "Truecolor text", RESET);
+
     return 0;
 }
@@ -0,0 +1,60 @@
+#define CLIB_IMPLEMENTATION
+#include "../clib.h"
+
+typedef struct {
+    int force;
+    Cstr branch;
+} AddOptions;
+
+typedef struct {
+    int verbose;
+} ListOptions;
+
+static AddOptions add_options;
+static ListOptions list_options;
+
+static int remote_add(int argc, char** argv, void* values, void* ctx){
+    (void) ctx;
+    AddOptions* options = (AddOptions*) values;
+    if(argc != 3){
+        ERRO("usage: commands remote add <name> <url>");
+        return 1;
+    }
+
+    INFO("Adding %s -> %s (branch: %s, force: %s)", argv[1], argv[2],
+        options->branch ? options->branch : "main", BOOL(options->force));
+    return 0;
+}
+
+static int remote_list(int argc, char** argv, void* values, void* ctx){
+    (void) argc;
+    (void) argv;
+    (void) ctx;
+    ListOptions* options = (ListOptions*) values;
+    INFO("origin%s", options->verbose ? "\thttps://github.com/KDesp73/clib.h" : "");
+    return 0;
+}
+
+static const ClibOption add_table[] = {
+    CLIB_OPTION('f', "force", "Overwrite an existing remote", CLIB_OPT_FLAG, no_argument, AddOptions, force),
+    CLIB_OPTION('b', "branch", "Branch to track", CLIB_OPT_STRING, required_argument, AddOptions, branch),
+};
+
+static const ClibOption list_table[] = {
+    CLIB_OPTION('v', "verbose", "Show the urls", CLIB_OPT_FLAG, no_argument, ListOptions, verbose),
+};
+
+static const ClibCommand remote_commands[] = {
+    { "add", "Add a remote", add_table, ARRAY_LEN(add_table), &add_options, remote_add, NULL, 0 },
+    { "list", "List the remotes", list_table, ARRAY_LEN(list_table), &list_options, remote_list, NULL, 0 },
+};
+
+static const ClibCommand commands[] = {
+    { "remote", "Manage remotes", NULL, 0, NULL, NULL, remote_commands, ARRAY_LEN(remote_commands) },
+};
+
+static const ClibCommand root = { "commands", "A git-style tool", NULL, 0, NULL, NULL, commands, ARRAY_LEN(commands) };
+
+int main(int argc, char** argv){
+    return clib_command_dispatch(&root, argc, argv, NULL);
+}
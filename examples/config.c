@@ -0,0 +1,31 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_CONFIG
+#include "../clib.h"
+
+enum { CONFIG_FILE, CONFIG_JOBS, CONFIG_NAME, CONFIG_COUNT };
+
+static const ClibConfigVar vars[CONFIG_COUNT] = {
+    [CONFIG_FILE] = { 'c', "config", "Config file to read", "APP_CONFIG", NULL, "app.toml" },
+    [CONFIG_JOBS] = { 'j', "jobs", "Number of jobs", "APP_JOBS", "build.jobs", "1" },
+    [CONFIG_NAME] = { 'n', "name", "Name to greet", "APP_NAME", "name", "World" },
+};
+
+int main(int argc, char** argv){
+    ClibConfig config;
+    clib_config_init(&config, vars, CONFIG_COUNT);
+
+    // The command line is parsed first, since it can point to another config file
+    argc = clib_config_parse_args(&config, argc, argv);
+    if(argc < 0) {
+        clib_config_help(&config, "config [-c <file>] [-j <jobs>] [-n <name>]", NULL);
+        return 1;
+    }
+    clib_config_resolve(&config);
+
+    clib_config_load_file(&config, clib_config_get(&config, CONFIG_FILE));
+
+    INFO("Hello %s, using %s jobs", clib_config_get(&config, CONFIG_NAME), clib_config_get(&config, CONFIG_JOBS));
+
+    clib_config_clean(&config);
+    return 0;
+}
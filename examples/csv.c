@@ -0,0 +1,58 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_CSV
+#include "../clib.h"
+
+#define THREADS 8
+
+typedef struct {
+    size_t column;
+    size_t records[THREADS];
+    double sums[THREADS];
+} Totals;
+
+// Each thread writes only its own slot, so nothing is shared
+static void sum_chunk(ClibCsv* chunk, size_t index, void* ctx){
+    Totals* totals = (Totals*) ctx;
+    while(clib_csv_next(chunk)){
+        totals->records[index]++;
+        if(totals->column >= chunk->field_count) continue;
+
+        // Fields are not NUL-terminated, so the number is copied out first
+        CstrView field = chunk->fields[totals->column];
+        char number[64];
+        size_t length = field.length < sizeof(number) - 1 ? field.length : sizeof(number) - 1;
+        memcpy(number, field.data, length);
+        number[length] = '\0';
+        totals->sums[index] += strtod(number, NULL);
+    }
+}
+
+int main(int argc, char** argv){
+    if(argc < 3){
+        ERRO("Usage: %s <file.csv|file.tsv> <column>", argv[0]);
+        return 1;
+    }
+
+    size_t length = strlen(argv[1]);
+    char delimiter = length > 4 && strcmp(argv[1] + length - 4, ".tsv") == 0 ? '\t' : ',';
+
+    ClibCsv csv;
+    if(clib_csv_open(&csv, argv[1], delimiter) != 0) return 1;
+
+    Totals totals = { .column = (size_t) atoi(argv[2]) };
+    clib_csv_parallel(&csv, THREADS, sum_chunk, &totals);
+
+    size_t records = 0;
+    double sum = 0;
+    for(size_t i = 0; i < THREADS; ++i){
+        records += totals.records[i];
+        sum += totals.sums[i];
+    }
+
+    char text[CLIB_DTOA_SIZE];
+    clib_dtoa(text, sum);
+    INFO("%zu records, column %zu sums to %s", records, totals.column, text);
+
+    clib_csv_close(&csv);
+    return 0;
+}
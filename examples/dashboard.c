@@ -0,0 +1,71 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_MENUS
+#include "../clib.h"
+
+typedef struct {
+    ClibScreen screen;
+    size_t frames;
+    int last_key;
+    int columns;
+    int rows;
+} Dashboard;
+
+static void draw(ClibLoop* loop, void* ctx){
+    (void) loop;
+    Dashboard* dashboard = (Dashboard*) ctx;
+    char line[128];
+
+    clib_screen_clear(&dashboard->screen);
+
+    int length = snprintf(line, sizeof(line), "%sDashboard%s (q to quit)", COLOR_FG(4), RESET);
+    clib_screen_put(&dashboard->screen, 0, 0, line, length);
+
+    length = snprintf(line, sizeof(line), "frame: %zu", dashboard->frames++);
+    clib_screen_put(&dashboard->screen, 1, 0, line, length);
+
+    length = snprintf(line, sizeof(line), "last key: %d", dashboard->last_key);
+    clib_screen_put(&dashboard->screen, 2, 0, line, length);
+
+    length = snprintf(line, sizeof(line), "terminal: %dx%d", dashboard->columns, dashboard->rows);
+    clib_screen_put(&dashboard->screen, 3, 0, line, length);
+
+    clib_screen_present(&dashboard->screen);
+}
+
+static void on_key(ClibLoop* loop, int key, void* ctx){
+    Dashboard* dashboard = (Dashboard*) ctx;
+    dashboard->last_key = key;
+    if(key == 'q') clib_loop_stop(loop);
+    draw(loop, ctx);
+}
+
+static void on_resize(ClibLoop* loop, int columns, int rows, void* ctx){
+    Dashboard* dashboard = (Dashboard*) ctx;
+    dashboard->columns = columns;
+    dashboard->rows = rows;
+    draw(loop, ctx);
+}
+
+int main(void){
+    Dashboard dashboard = { .last_key = CLIB_KEY_NONE };
+    clib_term_size(&dashboard.columns, &dashboard.rows);
+    clib_screen_init(&dashboard.screen, dashboard.columns, 4);
+
+    ClibLoop loop;
+    if(clib_loop_init(&loop) != 0) return 1;
+    clib_loop_on_key(&loop, on_key, &dashboard);
+    clib_loop_on_resize(&loop, on_resize, &dashboard);
+
+    // Redraw at 10 frames per second, whether or not a key comes in
+    clib_loop_add_timer(&loop, 0, 100, draw, &dashboard);
+
+    HIDE_CURSOR();
+    clib_loop_run(&loop);
+    clib_loop_free(&loop);
+
+    clib_screen_release(&dashboard.screen);
+    clib_screen_free(&dashboard.screen);
+    SHOW_CURSOR();
+
+    return 0;
+}
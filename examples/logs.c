@@ -3,6 +3,8 @@
 
 
 int main(int argc, char** argv){
+    clib_log_init(CLIB_LOG_TIMESTAMP | CLIB_LOG_TID | CLIB_LOG_LOCATION);
+
     Cstr str = CONCAT("Hello", " World");
     INFO("%s", str);
     WARN("This is a warning");
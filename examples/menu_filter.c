@@ -0,0 +1,33 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_MENUS
+#include "../clib.h"
+
+#define HOSTS 100000
+
+static Cstr regions[] = { "eu-west", "eu-central", "us-east", "us-west", "ap-south" };
+
+int main(void){
+    static char names[HOSTS][48];
+    static Cstr hosts[HOSTS];
+
+    for(size_t i = 0; i < HOSTS; ++i){
+        snprintf(names[i], sizeof(names[i]), "node-%05zu.%s.example.com", i, regions[i % 5]);
+        hosts[i] = names[i];
+    }
+
+    ClibMenuConfig config = {
+        .title = "Connect to (type to filter, esc to cancel)",
+        .color = 4,
+        .print_option = clib_arrow_print_option,
+        .items = hosts,
+        .count = HOSTS,
+        .visible_rows = 10,
+        .filter = true,
+    };
+
+    long choice = clib_menu_select(&config);
+    if(choice < 0) INFO("cancelled");
+    else INFO("choice: %s", hosts[choice]);
+
+    return 0;
+}
@@ -3,7 +3,7 @@
 #include "../clib.h"
 
 int main(void){
-    int choice = clib_menu("Title", 1, clib_brackets_print_option, "Option 1", "Option 2", "Option 3", "Option 4");
+    int choice = clib_menu("Title", 1, clib_brackets_print_option, "Option 1", "Option 2", "Option 3", "Option 4", NULL);
     INFO("choice: %d", choice);
 
     return 0;
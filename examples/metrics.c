@@ -0,0 +1,45 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_METRICS
+#include "../clib.h"
+
+#define THREADS 4
+
+static int requests;
+static int request_seconds;
+static int busy;
+
+static void* work(void* arg){
+    for(int i = 0; i < 50; ++i){
+        clib_metrics_gauge_add(busy, 1);
+        {
+            CLIB_METRIC_TIME(request_seconds);
+            char* output = clib_execute_command("echo hello");
+            free(output);
+        }
+        clib_metrics_add(requests, 1);
+        clib_metrics_gauge_add(busy, -1);
+        INFO_EVERY_N(25, "thread %d at request %d", (int) (intptr_t) arg, i);
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv){
+    // Point the node_exporter textfile collector at the directory, or pass unix:<path>
+    Cstr target = argc > 1 ? argv[1] : "metrics.prom";
+
+    requests = clib_metrics_counter("example_requests_total", "Requests handled");
+    request_seconds = clib_metrics_histogram("example_request_duration_seconds", "Time a request took");
+    busy = clib_metrics_gauge("example_busy_threads", "Threads in the middle of a request");
+
+    if(clib_metrics_export_start(target, 100) != 0) return 1;
+
+    pthread_t threads[THREADS];
+    for(intptr_t i = 0; i < THREADS; ++i) pthread_create(&threads[i], NULL, work, (void*) i);
+    for(int i = 0; i < THREADS; ++i) pthread_join(threads[i], NULL);
+
+    clib_metrics_export_stop();
+    INFO("%llu requests, %llu commands, written to %s",
+        (unsigned long long) clib_metrics_value(requests),
+        (unsigned long long) clib_metrics_value(CLIB_METRIC_COMMANDS), target);
+    return 0;
+}
@@ -0,0 +1,37 @@
+#define CLIB_IMPLEMENTATION
+#include "../clib.h"
+
+typedef struct {
+    int help;
+    int verbose;
+    Cstr file;
+    int jobs;
+} Options;
+
+static const ClibOption options[] = {
+    CLIB_OPTION('h', "help", "Prints this message", CLIB_OPT_FLAG, no_argument, Options, help),
+    CLIB_OPTION('v', "verbose", "Prints more", CLIB_OPT_FLAG, no_argument, Options, verbose),
+    CLIB_OPTION('f', "file", "Specify the file to parse", CLIB_OPT_STRING, required_argument, Options, file),
+    CLIB_OPTION('j', "jobs", "Number of jobs", CLIB_OPT_INT, required_argument, Options, jobs),
+};
+
+int main(int argc, char** argv){
+    static ClibOptParser parser;
+    if(clib_opt_parser_init(&parser, options, ARRAY_LEN(options)) != 0) return 1;
+
+    Options opts = { .jobs = 1 };
+    argc = clib_opt_parse(&parser, argc, argv, &opts);
+    if(argc < 0) return 1;
+
+    if(opts.help){
+        clib_opt_help(options, ARRAY_LEN(options), "options [-hv] [-j <jobs>] -f <file> [args...]", "Made by KDesp73");
+        return 0;
+    }
+
+    INFO("file: %s, jobs: %d, verbose: %s", opts.file ? opts.file : "(none)", opts.jobs, BOOL(opts.verbose));
+    for(int i = 1; i < argc; ++i){
+        INFO("positional: %s", argv[i]);
+    }
+
+    return 0;
+}
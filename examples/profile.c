@@ -0,0 +1,18 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_PROFILE
+#include "../clib.h"
+
+int main(){
+    // Open trace.json in chrome://tracing or ui.perfetto.dev
+    clib_profile_init("trace.json");
+
+    for(int i = 0; i < 10; ++i){
+        CLIB_PROFILE_ZONE("iteration");
+        char* output = clib_execute_command("ls -a");
+        CLIB_PROFILE_COUNTER("output size", strlen(output));
+        free(output);
+    }
+    INFO("Done");
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_PROGRESS
+#include "../clib.h"
+
+#define WORKERS 4
+#define ITEMS 50000000ull
+
+typedef struct {
+    ClibProgressBar* bar;
+    uint64_t items;
+} Job;
+
+static void* work(void* arg){
+    Job* job = (Job*) arg;
+    volatile uint64_t sum = 0;
+
+    // Reports every 1024 items, so the counter stays off the hot path
+    for(uint64_t i = 1; i <= job->items; ++i){
+        sum += i * i;
+        if((i & 1023) == 0) clib_progress_advance(job->bar, 1024);
+    }
+    clib_progress_advance(job->bar, job->items & 1023);
+    return NULL;
+}
+
+int main(void){
+    ClibProgress progress;
+    clib_progress_init(&progress, 0);
+
+    pthread_t threads[WORKERS];
+    Job jobs[WORKERS];
+    for(int i = 0; i < WORKERS; ++i){
+        char label[16];
+        snprintf(label, sizeof(label), "worker %d", i);
+        jobs[i] = (Job) { .bar = clib_progress_add_bar(&progress, label, ITEMS * (i + 1)), .items = ITEMS * (i + 1) };
+    }
+
+    clib_progress_start(&progress);
+    for(int i = 0; i < WORKERS; ++i) pthread_create(&threads[i], NULL, work, &jobs[i]);
+    for(int i = 0; i < WORKERS; ++i) pthread_join(threads[i], NULL);
+    clib_progress_stop(&progress);
+
+    INFO("done");
+    return 0;
+}
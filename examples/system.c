@@ -1,11 +1,26 @@
 #define CLIB_IMPLEMENTATION
 #include "../clib.h"
+#include <spawn.h>
+#include <sys/wait.h>
 
 int main(){
     printf("%s\n", clib_execute_command("ls -a"));
     
     INFO("%s", clib_get_env("HOME"));
+
+    // The child gets the environment of this process with one change
+    const ClibEnv* current = clib_env_current();
+    ClibEnvOverlay overlay;
+    clib_env_overlay_init(&overlay, current);
+    clib_env_release(current);
+    clib_env_overlay_set(&overlay, "GREETING", "hello from the parent");
+    ClibEnv* env = clib_env_overlay_freeze(&overlay);
+    clib_env_overlay_free(&overlay);
+
+    pid_t pid;
+    char* argv[] = { "sh", "-c", "echo $GREETING", NULL };
+    if(posix_spawn(&pid, "/bin/sh", NULL, NULL, argv, clib_env_envp(env)) == 0) waitpid(pid, NULL, 0);
+    clib_env_release(env);
     
     return 0;
 }
-
@@ -0,0 +1,29 @@
+#define CLIB_IMPLEMENTATION
+#include "../clib.h"
+
+int main(void){
+    ClibTableColumn columns[] = {
+        { .header = "PID", .align_right = true },
+        { .header = "USER" },
+        { .header = "STATE" },
+        { .header = "COMMAND", .max_width = 24 },
+    };
+
+    Cstr rows[][4] = {
+        { "1", "root", ANSI_GREEN "running" RESET, "/sbin/init splash" },
+        { "412", "kdesp73", ANSI_YELLOW "sleeping" RESET, "/usr/bin/pipewire" },
+        { "20311", "kdesp73", ANSI_RED "zombie" RESET, "/usr/lib/firefox/firefox -contentproc -isForBrowser" },
+    };
+
+    // Widths fit the rows seen so far, and long commands are cut to 24 columns
+    ClibTable table;
+    clib_table_init(&table, columns, 4, CLIB_TABLE_SAMPLED, STDOUT_FILENO);
+    table.truncate = true;
+
+    for(size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); ++i){
+        clib_table_row(&table, rows[i]);
+    }
+    clib_table_finish(&table);
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+#define CLIB_IMPLEMENTATION
+#define CLIB_MENUS
+#define CLIB_WATCHER
+#include "../clib.h"
+
+static void on_change(Cstr path, int changes, void* ctx){
+    (void) ctx;
+    INFO("%s:%s%s%s", path,
+        changes & CLIB_WATCH_CREATED ? " created" : "",
+        changes & CLIB_WATCH_MODIFIED ? " modified" : "",
+        changes & CLIB_WATCH_DELETED ? " deleted" : "");
+}
+
+static void on_key(ClibLoop* loop, int key, void* ctx){
+    (void) ctx;
+    if(key == 'q') clib_loop_stop(loop);
+}
+
+int main(int argc, char** argv){
+    if(argc < 2){
+        ERRO("Usage: %s <path>... (directories are watched recursively)", argv[0]);
+        return 1;
+    }
+
+    ClibWatcher watcher;
+    if(clib_watcher_init(&watcher, -1, on_change, NULL) != 0) return 1;
+    for(int i = 1; i < argc; ++i){
+        if(clib_watcher_add(&watcher, argv[i], true) != 0) return 1;
+    }
+
+    ClibLoop loop;
+    if(clib_loop_init(&loop) != 0) return 1;
+    clib_loop_on_key(&loop, on_key, NULL);
+    clib_watcher_attach(&watcher, &loop);
+
+    INFO("Watching, press q to quit");
+    clib_loop_run(&loop);
+
+    clib_watcher_free(&watcher);
+    clib_loop_free(&loop);
+    return 0;
+}